@@ -0,0 +1,155 @@
+// generate CLCXX_PACKAGE sources with n functions and n / 10 classes, then
+// report compile time, object size, dlopen and register_package time.
+// usage: clcxx-bench-bindings [n ...]   (default 1000 10000)
+
+#include <dlfcn.h>
+
+#include <chrono>
+#include <clcxx/clcxx.hpp>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+constexpr auto members_per_class = 4;
+// member types differ so that each gets its own accessor thunks
+constexpr const char *member_types[members_per_class] = {"int", "double",
+                                                         "float", "long"};
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void write_bindings(const fs::path &path, size_t n_functions,
+                    size_t n_classes) {
+  std::ofstream out(path);
+  out << "#include <clcxx/clcxx.hpp>\n#include <string>\n\n";
+  for (size_t i = 0; i < n_functions; ++i) {
+    if (i % 4 == 3) {
+      out << "std::string s" << i << "(const std::string &s) { return s + \""
+          << i << "\"; }\n";
+    } else {
+      out << "double f" << i << "(double x, int k) { return x * k + " << i
+          << "; }\n";
+    }
+  }
+  for (size_t j = 0; j < n_classes; ++j) {
+    out << "struct C" << j << " {\n  C" << j << "() = default;\n  explicit C"
+        << j << "(int a) : m0(a) {}\n";
+    for (size_t m = 0; m < members_per_class; ++m) {
+      out << "  " << member_types[m] << " m" << m << " = " << m << ";\n";
+    }
+    out << "  double sum() const { return m0 + m1 + m2 + m3; }\n};\n";
+  }
+  out << "\nCLCXX_PACKAGE Bench(clcxx::Package &pack) {\n";
+  for (size_t i = 0; i < n_functions; ++i) {
+    const auto fn = (i % 4 == 3 ? "s" : "f") + std::to_string(i);
+    out << "  pack.defun(\"" << fn << "\", F_PTR(&" << fn << "));\n";
+  }
+  for (size_t j = 0; j < n_classes; ++j) {
+    const auto cls = "C" + std::to_string(j);
+    out << "  pack.defclass<" << cls << ", true>(\"" << cls
+        << "\")\n      .constructor<int>()\n";
+    for (size_t m = 0; m < members_per_class; ++m) {
+      out << "      .member(\"m" << m << "\", &" << cls << "::m" << m
+          << ")\n";
+    }
+    out << "      .defmethod(\"sum\", F_PTR(&" << cls << "::sum));\n";
+  }
+  out << "}\n";
+}
+
+/// run a shell command, returns its wall time
+double run(const std::string &command) {
+  const auto start = Clock::now();
+  if (std::system(command.c_str()) != 0) {
+    throw std::runtime_error("command failed: " + command);
+  }
+  return seconds_since(start);
+}
+
+void bench(size_t n_functions, const fs::path &dir) {
+  const auto n_classes = n_functions / 10;
+  const auto name = "bindings_" + std::to_string(n_functions);
+  const auto source = dir / (name + ".cpp");
+  const auto object = dir / (name + ".o");
+  const auto library = dir / ("lib" + name + ".so");
+  write_bindings(source, n_functions, n_classes);
+
+  const std::string cxx = CLCXX_BENCH_CXX;
+  const auto compile_time =
+      run(cxx + " -std=c++17 -O2 -fPIC -I" CLCXX_BENCH_INCLUDE " -c " +
+          source.string() + " -o " + object.string());
+  const auto link_time =
+      run(cxx + " -shared " + object.string() + " -o " + library.string() +
+          " -L" CLCXX_BENCH_LIB_DIR " -lClCxx");
+
+  auto start = Clock::now();
+  auto handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+  const auto dlopen_time = seconds_since(start);
+  if (handle == nullptr) {
+    throw std::runtime_error(std::string("dlopen: ") + dlerror());
+  }
+  auto regfunc = reinterpret_cast<void (*)(clcxx::Package &)>(
+      dlsym(handle, "Bench"));
+
+  start = Clock::now();
+  const auto registered = register_package(name.c_str(), regfunc);
+  const auto register_time = seconds_since(start);
+  if (!registered) {
+    throw std::runtime_error("register_package failed for " + name);
+  }
+  const auto n_thunks =
+      clcxx::registry().get_package_iter(name)->second->thunks().size();
+  clcxx::registry().remove_package(name);
+  dlclose(handle);
+
+  std::cout << std::setw(9) << n_functions << std::setw(9) << n_classes
+            << std::setw(9) << n_thunks << std::fixed << std::setprecision(2)
+            << std::setw(12) << compile_time << std::setw(10) << link_time
+            << std::setw(12) << fs::file_size(object) / 1024.0
+            << std::setw(12) << fs::file_size(library) / 1024.0
+            << std::setprecision(3) << std::setw(12) << dlopen_time * 1e3
+            << std::setw(14) << register_time * 1e3 << "\n";
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  std::vector<size_t> sizes;
+  for (int i = 1; i < argc; ++i) {
+    sizes.push_back(std::strtoul(argv[i], nullptr, 10));
+  }
+  if (sizes.empty()) sizes = {1000, 10000};
+
+  clcxx::registry().set_error_handler(
+      [](char *err_msg) { std::cerr << err_msg << "\n"; });
+  // meta data is only counted by register_package here
+  clcxx::registry().set_meta_data_handler([](clcxx::MetaData *, uint8_t) {});
+
+  const auto dir = fs::temp_directory_path() / "clcxx-bench-bindings";
+  fs::create_directories(dir);
+  std::cout << std::setw(9) << "funcs" << std::setw(9) << "classes"
+            << std::setw(9) << "thunks" << std::setw(12) << "compile s"
+            << std::setw(10) << "link s" << std::setw(12) << "object KiB"
+            << std::setw(12) << "so KiB" << std::setw(12) << "dlopen ms"
+            << std::setw(14) << "register ms" << "\n";
+  try {
+    for (auto n : sizes) {
+      bench(n, dir);
+    }
+  } catch (const std::exception &err) {
+    std::cerr << err.what() << "\n";
+    return 1;
+  }
+  fs::remove_all(dir);
+  return 0;
+}
@@ -0,0 +1,274 @@
+// allocate/free patterns of the bindings against MemPool(), new/delete and
+// an unsynchronized pool per thread, for 1 to N threads.
+// usage: clcxx-bench-mempool [max-threads] [ops-per-thread]
+
+#include <algorithm>
+#include <chrono>
+#include <clcxx/clcxx.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// string results boxed for lisp, see ConvertToLisp<std::string>
+constexpr size_t string_sizes[] = {8, 24, 100, 500, 2000};
+// allocations alive at once in each thread, lisp frees them later
+constexpr size_t live_window = 64;
+
+struct Object {
+  double mass = 1.5;
+  std::string name = "electron";
+  int id = 7;
+};
+
+enum class Allocator { mem_pool, new_delete, thread_pool };
+
+const char *allocator_name(Allocator allocator) {
+  switch (allocator) {
+    case Allocator::mem_pool:
+      return "MemPool";
+    case Allocator::new_delete:
+      return "new/delete";
+    default:
+      return "thread pool";
+  }
+}
+
+std::pmr::memory_resource *resource(Allocator allocator) {
+  switch (allocator) {
+    case Allocator::mem_pool:
+      return &clcxx::MemPool();
+    case Allocator::new_delete:
+      return std::pmr::new_delete_resource();
+    default:
+      thread_local std::pmr::unsynchronized_pool_resource pool;
+      return &pool;
+  }
+}
+
+/// per thread latencies in nanoseconds of single allocate/deallocate calls
+class Timer {
+ public:
+  explicit Timer(size_t n) { p_samples.reserve(n); }
+
+  template <typename F>
+  auto operator()(F &&f) {
+    const auto start = Clock::now();
+    if constexpr (std::is_void_v<decltype(f())>) {
+      f();
+      p_samples.push_back(elapsed(start));
+    } else {
+      auto result = f();
+      p_samples.push_back(elapsed(start));
+      return result;
+    }
+  }
+
+  std::vector<uint32_t> &samples() { return p_samples; }
+
+ private:
+  static uint32_t elapsed(Clock::time_point start) {
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                             start)
+            .count());
+  }
+
+  std::vector<uint32_t> p_samples;
+};
+
+struct Block {
+  void *ptr;
+  size_t size;
+};
+
+void strings(Allocator allocator, size_t ops, Timer &timer) {
+  auto *res = resource(allocator);
+  std::deque<Block> live;
+  for (size_t i = 0; i < ops; ++i) {
+    const auto size = string_sizes[i % std::size(string_sizes)] + 1;
+    auto ptr = timer([&] { return res->allocate(size, alignof(char)); });
+    std::memset(ptr, 'x', size);
+    live.push_back({ptr, size});
+    if (live.size() > live_window) {
+      const auto block = live.front();
+      live.pop_front();
+      timer([&] { res->deallocate(block.ptr, block.size, alignof(char)); });
+    }
+  }
+  for (const auto &block : live) {
+    res->deallocate(block.ptr, block.size, alignof(char));
+  }
+}
+
+void objects(Allocator allocator, size_t ops, Timer &timer) {
+  auto *res = resource(allocator);
+  std::deque<Object *> live;
+  for (size_t i = 0; i < ops; ++i) {
+    auto obj = timer([&] {
+      return ::new (res->allocate(sizeof(Object), alignof(Object))) Object();
+    });
+    live.push_back(obj);
+    if (live.size() > live_window) {
+      auto old = live.front();
+      live.pop_front();
+      timer([&] {
+        old->~Object();
+        res->deallocate(old, sizeof(Object), alignof(Object));
+      });
+    }
+  }
+  for (auto obj : live) {
+    obj->~Object();
+    res->deallocate(obj, sizeof(Object), alignof(Object));
+  }
+}
+
+/// batches allocated by one thread and freed by the next one
+class Handoff {
+ public:
+  explicit Handoff(size_t n_threads) : p_queues(n_threads) {}
+
+  void push(size_t to, std::vector<Block> batch) {
+    {
+      std::lock_guard<std::mutex> lock(p_mutex);
+      p_queues[to].push_back(std::move(batch));
+    }
+    p_cv.notify_all();
+  }
+
+  std::vector<Block> pop(size_t thread) {
+    std::unique_lock<std::mutex> lock(p_mutex);
+    p_cv.wait(lock, [&] { return !p_queues[thread].empty(); });
+    auto batch = std::move(p_queues[thread].front());
+    p_queues[thread].pop_front();
+    return batch;
+  }
+
+ private:
+  std::vector<std::deque<std::vector<Block>>> p_queues;
+  std::mutex p_mutex;
+  std::condition_variable p_cv;
+};
+
+void cross_thread(Allocator allocator, size_t ops, Timer &timer,
+                  Handoff &handoff, size_t thread, size_t n_threads) {
+  auto *res = resource(allocator);
+  const auto next = (thread + 1) % n_threads;
+  for (size_t done = 0; done < ops; done += live_window) {
+    std::vector<Block> batch;
+    for (size_t i = 0; i < live_window; ++i) {
+      const auto size = string_sizes[i % std::size(string_sizes)] + 1;
+      batch.push_back(
+          {timer([&] { return res->allocate(size, alignof(char)); }), size});
+    }
+    handoff.push(next, std::move(batch));
+    for (const auto &block : handoff.pop(thread)) {
+      timer([&] { res->deallocate(block.ptr, block.size, alignof(char)); });
+    }
+  }
+}
+
+enum class Pattern { strings, objects, cross_thread };
+
+const char *pattern_name(Pattern pattern) {
+  switch (pattern) {
+    case Pattern::strings:
+      return "strings";
+    case Pattern::objects:
+      return "objects";
+    default:
+      return "cross-thread";
+  }
+}
+
+void run(Pattern pattern, Allocator allocator, size_t n_threads,
+         size_t ops) {
+  Handoff handoff(n_threads);
+  std::vector<Timer> timers(n_threads, Timer(2 * ops));
+  std::vector<std::thread> threads;
+  const auto start = Clock::now();
+  for (size_t t = 0; t < n_threads; ++t) {
+    threads.emplace_back([&, t] {
+      switch (pattern) {
+        case Pattern::strings:
+          strings(allocator, ops, timers[t]);
+          break;
+        case Pattern::objects:
+          objects(allocator, ops, timers[t]);
+          break;
+        case Pattern::cross_thread:
+          cross_thread(allocator, ops, timers[t], handoff, t, n_threads);
+          break;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  const auto seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::vector<uint32_t> samples;
+  for (auto &timer : timers) {
+    samples.insert(samples.end(), timer.samples().begin(),
+                   timer.samples().end());
+  }
+  std::sort(samples.begin(), samples.end());
+  const auto percentile = [&samples](double p) {
+    return samples.empty()
+               ? 0
+               : samples[std::min(samples.size() - 1,
+                                  static_cast<size_t>(p * samples.size()))];
+  };
+  std::cout << std::left << std::setw(14) << pattern_name(pattern)
+            << std::setw(13) << allocator_name(allocator) << std::right
+            << std::setw(8) << n_threads << std::setw(14) << std::fixed
+            << std::setprecision(2) << samples.size() / seconds / 1e6
+            << std::setw(9) << percentile(0.5) << std::setw(9)
+            << percentile(0.99) << std::setw(9) << percentile(0.999)
+            << std::setw(10) << samples.back() << "\n";
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  const size_t max_threads =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+               : std::max(1u, std::thread::hardware_concurrency());
+  const size_t ops = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200000;
+
+  std::cout << std::left << std::setw(14) << "pattern" << std::setw(13)
+            << "allocator" << std::right << std::setw(8) << "threads"
+            << std::setw(14) << "Mops/s" << std::setw(9) << "p50 ns"
+            << std::setw(9) << "p99 ns" << std::setw(9) << "p99.9 ns"
+            << std::setw(10) << "max ns" << "\n";
+  for (auto pattern :
+       {Pattern::strings, Pattern::objects, Pattern::cross_thread}) {
+    for (auto allocator : {Allocator::mem_pool, Allocator::new_delete,
+                           Allocator::thread_pool}) {
+      // an unsynchronized pool can't free blocks of another thread
+      if (pattern == Pattern::cross_thread &&
+          allocator == Allocator::thread_pool) {
+        continue;
+      }
+      for (size_t n = 1; n <= max_threads; n *= 2) {
+        if (pattern == Pattern::cross_thread && n == 1) continue;
+        run(pattern, allocator, n, ops);
+      }
+    }
+  }
+  return 0;
+}
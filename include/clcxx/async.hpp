@@ -0,0 +1,96 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "clcxx_config.hpp"
+#include "package.hpp"
+
+namespace clcxx {
+
+/// fixed number of worker threads running tasks in submission order
+class CLCXX_API ThreadPool {
+ public:
+  explicit ThreadPool(size_t n_threads);
+  /// finish the queued tasks then join the workers
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void submit(std::function<void()> task);
+  size_t size() const { return p_workers.size(); }
+
+ private:
+  void work();
+
+  std::vector<std::thread> p_workers;
+  std::deque<std::function<void()>> p_tasks;
+  std::mutex p_mutex;
+  std::condition_variable p_cv;
+  bool p_stop;
+};
+
+/// pool used by async calls, hardware concurrency threads by default.
+/// Callers keep the returned pointer while they use the pool
+CLCXX_API std::shared_ptr<ThreadPool> AsyncPool();
+
+/// replace the async pool, the old pool finishes its queued calls once its
+/// last user releases it
+CLCXX_API void set_async_pool_size(size_t n_threads);
+
+enum class AsyncState : int {
+  queued = 0,
+  running = 1,
+  done = 2,
+  failed = 3,
+  cancelled = 4
+};
+
+/// one call of a thunk on the async pool. Argument values are copied on
+/// submission, memory they point to (strings, objects) should stay alive
+/// until the call is finished
+class CLCXX_API AsyncCall {
+ public:
+  AsyncCall(const detail::PackedSignature &signature, void **args);
+
+  AsyncCall(const AsyncCall &) = delete;
+  AsyncCall &operator=(const AsyncCall &) = delete;
+
+  void run();
+  AsyncState state();
+  /// negative timeout waits until the call is finished
+  AsyncState wait(int64_t timeout_ms);
+  /// only calls which did not start yet could be cancelled
+  bool cancel();
+  /// copy the result of a done call, throws for failed or cancelled calls
+  void collect(void *result);
+
+ private:
+  const detail::PackedSignature &p_signature;
+  std::vector<std::max_align_t> p_storage;
+  std::vector<void *> p_args;
+  void *p_result;
+  std::string p_error;
+  AsyncState p_state;
+  std::mutex p_mutex;
+  std::condition_variable p_cv;
+};
+
+/// call the thunk of signature for each of n elements, input_columns has
+/// one column per argument, output (unused for void) gets the results.
+/// Chunks of the batch are taken by up to n_threads threads (0: pool size)
+/// including the caller, the first error is thrown after the batch stops
+CLCXX_API void ParallelMap(const detail::PackedSignature &signature,
+                           void **input_columns, void *output, size_t n,
+                           size_t n_threads);
+
+}  // namespace clcxx
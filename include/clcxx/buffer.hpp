@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+
+#include "clcxx_config.hpp"
+
+namespace clcxx {
+
+constexpr auto BUFFER_MAX_DIMS = 8;
+
+// buffer protocol: a C++ object exposes its storage to lisp
+// so that it could be wrapped as a displaced array.
+// strides are counted in elements not bytes.
+extern "C" typedef struct {
+  void *data;
+  size_t item_size;
+  size_t ndim;
+  size_t shape[BUFFER_MAX_DIMS];
+  ptrdiff_t strides[BUFFER_MAX_DIMS];
+} BufferInfo;
+
+/// Typed view over the storage of a C++ object
+template <typename T>
+struct Buffer {
+  using value_type = T;
+
+  /// empty strides => contiguous row-major layout
+  Buffer(T *data, std::initializer_list<size_t> shape,
+         std::initializer_list<ptrdiff_t> strides = {})
+      : info{} {
+    if (shape.size() == 0 || shape.size() > BUFFER_MAX_DIMS) {
+      throw std::runtime_error("Buffer dimensions should be in [1, " +
+                               std::to_string(BUFFER_MAX_DIMS) + "]");
+    }
+    if (strides.size() != 0 && strides.size() != shape.size()) {
+      throw std::runtime_error("Buffer shape and strides length mismatch");
+    }
+    info.data = const_cast<void *>(static_cast<const void *>(data));
+    info.item_size = sizeof(T);
+    info.ndim = shape.size();
+    size_t i = 0;
+    for (auto dim : shape) {
+      info.shape[i++] = dim;
+    }
+    if (strides.size() == 0) {
+      ptrdiff_t stride = 1;
+      for (auto j = info.ndim; j-- > 0;) {
+        info.strides[j] = stride;
+        stride *= static_cast<ptrdiff_t>(info.shape[j]);
+      }
+    } else {
+      i = 0;
+      for (auto stride : strides) {
+        info.strides[i++] = stride;
+      }
+    }
+  }
+
+  BufferInfo info;
+};
+
+}  // namespace clcxx
@@ -10,5 +10,6 @@
 #include <typeinfo>
 #include <vector>
 
+#include "async.hpp"
 #include "package.hpp"
 #include "type_conversion.hpp"
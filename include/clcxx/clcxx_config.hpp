@@ -12,6 +12,52 @@
 #define CLCXX_ONLY_EXPORTS CLCXX_API
 #endif
 
+// thunks and their statics are only reached through pointers, keep them
+// out of the dynamic symbol table of the binding library
+#ifdef _WIN32
+#define CLCXX_HIDDEN
+#else
+#define CLCXX_HIDDEN __attribute__((visibility("hidden")))
+#endif
+
+// POD structs bigger than this (in bytes) are passed by const pointer
+// and returned through a caller provided pointer
+#ifndef CLCXX_POD_BY_VALUE_MAX_SIZE
+#define CLCXX_POD_BY_VALUE_MAX_SIZE 64
+#endif
+
+// members of one class sharing a type that ClassWrapper::member(name, pm)
+// can bind, each of them gets its own set of thunks
+#ifndef CLCXX_MEMBERS_PER_TYPE
+#define CLCXX_MEMBERS_PER_TYPE 8
+#endif
+
+// 1: thunks of the binding library count calls, errors and latencies,
+// read them with profile_snapshot. 0 compiles the counters out
+#ifndef CLCXX_PROFILE
+#define CLCXX_PROFILE 0
+#endif
+
+// 1: thunks of the binding library record trace events while trace_start
+// is on, see trace.hpp, and so do the pool and slab resources.
+// Package events are recorded either way
+#ifndef CLCXX_TRACE
+#define CLCXX_TRACE 0
+#endif
+
+// 1: class objects allocated for lisp are recorded in a table of handles,
+// handles passed back to C++ are checked against it. Set it the same way
+// in every binding library that shares class types
+#ifndef CLCXX_CHECKED_HANDLES
+#define CLCXX_CHECKED_HANDLES 0
+#endif
+
+// number of freed handles the library remembers to report use after free,
+// the oldest are forgotten first and pass the check like unknown pointers
+#ifndef CLCXX_FREED_HANDLES
+#define CLCXX_FREED_HANDLES 65536
+#endif
+
 #define CLCXX_VERSION_MAJOR 1
 #define CLCXX_VERSION_MINOR 0
 #define CLCXX_VERSION_PATCH 0
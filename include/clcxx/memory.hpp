@@ -1,8 +1,17 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <memory_resource>
+#include <mutex>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 #include "clcxx_config.hpp"
+#include "hash_type.hpp"
+#include "trace.hpp"
 
 namespace clcxx {
 
@@ -18,11 +27,17 @@ class VerboseResource : public std::pmr::memory_resource {
 
  private:
   void *do_allocate(size_t bytes, size_t alignment) override {
+#if CLCXX_TRACE
+    if (detail::tracing()) detail::trace_instant("pool-allocate", bytes);
+#endif
     num_of_bytes_allocated += bytes;
     return upstream_resource_->allocate(bytes, alignment);
   }
 
   void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+#if CLCXX_TRACE
+    if (detail::tracing()) detail::trace_instant("pool-deallocate", bytes);
+#endif
     num_of_bytes_allocated -= bytes;
     upstream_resource_->deallocate(p, bytes, alignment);
   }
@@ -33,9 +48,139 @@ class VerboseResource : public std::pmr::memory_resource {
   }
 
   std::pmr::memory_resource *upstream_resource_;
-  size_t num_of_bytes_allocated;
+  // updated from async and parallel calls too
+  std::atomic<size_t> num_of_bytes_allocated;
 };
 
 [[nodiscard]] CLCXX_API VerboseResource &MemPool();
 
+/// fixed size blocks for objects of one type, free blocks are kept in a
+/// list and chunks are only returned to upstream on destruction
+class CLCXX_API SlabResource : public std::pmr::memory_resource {
+ public:
+  SlabResource(size_t object_size, size_t object_alignment,
+               std::pmr::memory_resource *upstream_resource =
+                   std::pmr::new_delete_resource());
+  ~SlabResource() override;
+
+  SlabResource(const SlabResource &) = delete;
+  SlabResource &operator=(const SlabResource &) = delete;
+
+  /// make sure n blocks are free, new blocks are contiguous
+  void reserve(size_t n);
+
+  size_t block_size() const { return block_size_; }
+  size_t free_blocks();
+
+ private:
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+  [[nodiscard]] bool do_is_equal(
+      const memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+  bool fits(size_t bytes, size_t alignment) const {
+    return bytes <= block_size_ && alignment <= alignment_;
+  }
+  void grow(size_t n);
+
+  std::pmr::memory_resource *upstream_resource_;
+  size_t block_size_;
+  size_t alignment_;
+  size_t next_chunk_blocks_;
+  size_t num_of_free_blocks_;
+  FreeBlock *free_list_;
+  std::vector<std::pair<void *, size_t>> chunks_;
+  std::mutex mutex_;
+};
+
+namespace detail {
+
+/// type tag of objects of T in the table of live handles
+template <typename T>
+constexpr uint32_t handle_tag() {
+  return static_cast<uint32_t>(Hash32TypeName<T>());
+}
+
+/// record that objects tagged tag may be passed as base_tag
+CLCXX_API void register_handle_base(uint32_t tag, uint32_t base_tag);
+CLCXX_API bool handle_derives(uint32_t tag, uint32_t base_tag);
+
+/// objects allocated for lisp are kept in a table of live handles,
+/// and recently freed ones in a table of freed handles
+CLCXX_API void track_handle(const void *ptr, uint32_t tag);
+CLCXX_API void untrack_handle(const void *ptr);
+
+/// throws for handles of freed objects and of unrelated classes,
+/// pointers in neither table (returned references, placed objects) pass
+CLCXX_API void check_handle(const void *ptr, uint32_t tag,
+                            std::string_view type_name);
+
+}  // namespace detail
+
+/// memory resource for objects of type T passed to lisp,
+/// MemPool() unless a slab is attached by ClassWrapper::slab()
+template <typename T>
+std::pmr::memory_resource *&object_resource() {
+  static std::pmr::memory_resource *resource = &MemPool();
+  return resource;
+}
+
+/// number of objects of type T allocated from object_resource<T>()
+template <typename T>
+std::atomic<size_t> &live_objects() {
+  static std::atomic<size_t> count{0};
+  return count;
+}
+
+/// slab of type T, alive until the process exits
+template <typename T>
+SlabResource &type_slab() {
+  static auto &slab = *new SlabResource(sizeof(T), alignof(T));
+  return slab;
+}
+
+template <typename T>
+T *allocate_object() {
+  auto ptr = static_cast<T *>(
+      object_resource<T>()->allocate(sizeof(T), alignof(T)));
+  live_objects<T>().fetch_add(1, std::memory_order_relaxed);
+  if constexpr (CLCXX_CHECKED_HANDLES != 0) {
+    detail::track_handle(ptr, detail::handle_tag<T>());
+  }
+  return ptr;
+}
+
+template <typename T>
+void deallocate_object(void *ptr) {
+  if constexpr (CLCXX_CHECKED_HANDLES != 0) {
+    detail::untrack_handle(ptr);
+  }
+  object_resource<T>()->deallocate(ptr, sizeof(T), alignof(T));
+  live_objects<T>().fetch_sub(1, std::memory_order_relaxed);
+}
+
+/// handle from lisp as T*, with CLCXX_CHECKED_HANDLES it is looked up in
+/// the handle tables first
+template <typename T>
+inline T *checked_handle(const void *ptr) {
+#if CLCXX_CHECKED_HANDLES
+  using ClassT = std::remove_cv_t<T>;
+  if (ptr != nullptr) {
+    detail::check_handle(ptr, detail::handle_tag<ClassT>(),
+                         TypeName<ClassT>());
+  }
+#endif
+  return const_cast<T *>(static_cast<const T *>(ptr));
+}
+
+/// pointer to a copy of str in a table that lives until the process exits,
+/// equal strings share the same pointer
+[[nodiscard]] CLCXX_API const char *intern_string(std::string_view str);
+
 }  // namespace clcxx
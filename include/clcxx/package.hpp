@@ -1,15 +1,25 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <functional>
+#include <iterator>
 #include <map>
 #include <memory>
 #include <memory_resource>
+#include <new>
 #include <string>
 #include <string_view>
 #include <type_traits>
+#include <typeindex>
+#include <typeinfo>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "buffer.hpp"
+#include "profile.hpp"
+#include "trace.hpp"
 #include "type_conversion.hpp"
 
 /// helpper for Import function
@@ -22,10 +32,31 @@ namespace clcxx {
 extern "C" typedef struct {
   char *name;
   char *super_classes;
+  char *super_offsets;    // base pointer - derived pointer, per super class
+  void (*dynamic_class)();  // int64_t (*)(const void *class_indexes,
+                            //            void *obj, void **most_derived)
+                            // null := not polymorphic
   char *slot_names;
   char *slot_types;
+  char *slot_offsets;     // -1 := not standard layout
+  char *slot_sizes;
+  char *slot_alignments;
   void (*constructor)();  // null := pod class
+  char *constructors;     // names of the constructor<Args...>() functions
   void (*destructor)();   // null := pod class
+  void (*destruct)();     // void (*)(void *obj), no deallocation
+  size_t size;
+  size_t alignment;
+  void (*reserve)();      // void (*)(size_t n), null := no slab
+  char *buffer_type;      // null := no buffer protocol
+  void (*buffer)();       // void (*)(void *obj, BufferInfo *out)
+  void (*snapshot)();     // void (*)(const void *slot_table, void *obj,
+                          //          void *buffer)
+  void (*restore)();      // void (*)(const void *slot_table, void *obj,
+                          //          const void *buffer)
+  const void *slot_table;  // owned by the package, see class_slot_table
+  size_t snapshot_size;
+  char *snapshot_offsets;
 } ClassInfo;
 
 extern "C" typedef struct {
@@ -35,6 +66,10 @@ extern "C" typedef struct {
   void (*func_ptr)();
   char *arg_types;
   char *return_type;
+  bool out_return_p;  // result is written to a pointer passed as 1st arg
+                      // (placed results: constructed there, destruct later)
+  char *overload_tags;          // null := not overloaded, see OverloadTag
+  char *overload_return_types;  // one per overload tag
 } FunctionInfo;
 
 extern "C" typedef struct {
@@ -61,65 +96,195 @@ struct is_functional<std::function<T>> : public std::true_type {};
 template <typename T>
 inline constexpr bool is_functional_v = is_functional<T>::value;
 
+template <auto invocable_pointer, typename... Args>
+inline decltype(auto) Invoke(Args &&...args) {
+  if constexpr (std::is_invocable_v<decltype(invocable_pointer), Args...>) {
+    return std::invoke(invocable_pointer, std::forward<Args>(args)...);
+  } else {
+    return std::invoke(*invocable_pointer, std::forward<Args>(args)...);
+  }
+}
+
+using FuncPtr = void (*)();
+
+/// type erased thunk call, args points to the lisp values of the
+/// arguments. Errors are thrown so that it could run off the lisp thread
+struct PackedSignature {
+  void (*call)(void **args, void *result);
+  std::vector<size_t> arg_sizes;
+  std::vector<size_t> arg_alignments;
+  size_t result_size;  // 0 for void
+  size_t result_alignment;
+};
+
+using SignatureGetter = const PackedSignature &(*)();
+
+/// record the packed signature of a thunk imported while a package is
+/// being registered, nothing is recorded outside of registration
+CLCXX_API void note_signature(FuncPtr thunk, SignatureGetter signature);
+
+/// nullptr if no registered package has a packed signature for thunk
+CLCXX_API const PackedSignature *find_signature(FuncPtr thunk);
+
+template <auto invocable_pointer, typename R, typename... Args,
+          std::size_t... I>
+CLCXX_HIDDEN void PackedCallImpl(void **args, void *result,
+                                 std::index_sequence<I...>) {
+  if constexpr (std::is_same_v<ToCpp_t<R>, void>) {
+    Invoke<invocable_pointer>(
+        ToCpp<Args>(std::move(*static_cast<ToLisp_t<Args> *>(args[I])))...);
+  } else {
+    *static_cast<ToLisp_t<R> *>(result) = ToLisp<R>(Invoke<invocable_pointer>(
+        ToCpp<Args>(std::move(*static_cast<ToLisp_t<Args> *>(args[I])))...));
+  }
+}
+
 template <auto invocable_pointer, typename R, typename... Args>
-ToLisp_t<R> DoApply(ToLisp_t<Args>... args) {
+CLCXX_HIDDEN void PackedCall(void **args, void *result) {
+  PackedCallImpl<invocable_pointer, R, Args...>(
+      args, result, std::index_sequence_for<Args...>());
+}
+
+template <typename R>
+constexpr std::size_t result_size() {
+  if constexpr (std::is_same_v<ToCpp_t<R>, void>) {
+    return 0;
+  } else {
+    return sizeof(ToLisp_t<R>);
+  }
+}
+
+template <typename R>
+constexpr std::size_t result_alignment() {
+  if constexpr (std::is_same_v<ToCpp_t<R>, void>) {
+    return 1;
+  } else {
+    return alignof(ToLisp_t<R>);
+  }
+}
+
+/// built on the first async call of the thunk
+template <auto invocable_pointer, typename R, typename... Args>
+CLCXX_HIDDEN const PackedSignature &packed_signature() {
+  static const PackedSignature signature{
+      &PackedCall<invocable_pointer, R, Args...>,
+      {sizeof(ToLisp_t<Args>)...},
+      {alignof(ToLisp_t<Args>)...},
+      result_size<R>(),
+      result_alignment<R>()};
+  return signature;
+}
+
+template <auto invocable_pointer, typename R, typename... Args>
+CLCXX_HIDDEN ToLisp_t<R> DoApply(ToLisp_t<Args>... args) {
+#if CLCXX_PROFILE
+  static const auto slot = profile_slot(
+      reinterpret_cast<FuncPtr>(&DoApply<invocable_pointer, R, Args...>));
+  ProfileScope profile(slot);
+#endif
+#if CLCXX_TRACE
+  TraceScope trace(
+      nullptr,
+      reinterpret_cast<FuncPtr>(&DoApply<invocable_pointer, R, Args...>));
+#endif
   try {
-    if constexpr (std::is_invocable_v<decltype(invocable_pointer),
-                                      ToCpp_t<Args>...>) {
-      if constexpr (std::is_same_v<ToCpp_t<R>, void>) {
-        std::invoke(invocable_pointer, ToCpp<Args>(std::move(args))...);
-        return;
-      } else {
-        return ToLisp<R>(
-            std::invoke(invocable_pointer, ToCpp<Args>(std::move(args))...));
-      }
+    if constexpr (std::is_same_v<ToCpp_t<R>, void>) {
+      Invoke<invocable_pointer>(ToCpp<Args>(std::move(args))...);
+      return;
     } else {
-      if constexpr (std::is_same_v<ToCpp_t<R>, void>) {
-        std::invoke(*invocable_pointer, ToCpp<Args>(std::move(args))...);
-        return;
-      } else {
-        return ToLisp<R>(
-            std::invoke(*invocable_pointer, ToCpp<Args>(std::move(args))...));
-      }
+      return ToLisp<R>(
+          Invoke<invocable_pointer>(ToCpp<Args>(std::move(args))...));
     }
   } catch (const std::exception &err) {
+#if CLCXX_PROFILE
+    profile.error();
+#endif
+#if CLCXX_TRACE
+    trace.finish();
+#endif
     LispError(err.what());
   }
   return ToLisp_t<R>();
 }
 
+/// result is written to the caller provided pointer `out`
+template <auto invocable_pointer, typename R, typename... Args>
+CLCXX_HIDDEN void DoApplyOut(void *out, ToLisp_t<Args>... args) {
+#if CLCXX_PROFILE
+  static const auto slot = profile_slot(
+      reinterpret_cast<FuncPtr>(&DoApplyOut<invocable_pointer, R, Args...>));
+  ProfileScope profile(slot);
+#endif
+#if CLCXX_TRACE
+  TraceScope trace(
+      nullptr,
+      reinterpret_cast<FuncPtr>(&DoApplyOut<invocable_pointer, R, Args...>));
+#endif
+  try {
+    internal::ConvertToLisp<R>()(
+        out, Invoke<invocable_pointer>(ToCpp<Args>(std::move(args))...));
+  } catch (const std::exception &err) {
+#if CLCXX_PROFILE
+    profile.error();
+#endif
+#if CLCXX_TRACE
+    trace.finish();
+#endif
+    LispError(err.what());
+  }
+}
+
+/// thunk of an invocable, signature is null if it can't run asynchronously
+template <typename ThunkT>
+struct ResolvedThunk {
+  ThunkT thunk;
+  SignatureGetter signature;
+};
+
+template <auto invocable_pointer, typename R, typename... Args>
+constexpr auto ApplyThunk() {
+  if constexpr (internal::is_out_return_v<R>) {
+    constexpr auto thunk = &DoApplyOut<invocable_pointer, R, Args...>;
+    return ResolvedThunk<decltype(thunk)>{thunk, nullptr};
+  } else {
+    constexpr auto thunk = &DoApply<invocable_pointer, R, Args...>;
+    return ResolvedThunk<decltype(thunk)>{
+        thunk, &packed_signature<invocable_pointer, R, Args...>};
+  }
+}
+
 template <auto std_func_ptr, typename R, typename... Args>
 constexpr auto ResolveInvocable(std::function<R(Args...)> *) {
-  return &DoApply<std_func_ptr, std::remove_const_t<R>,
-                  std::remove_const_t<Args>...>;
+  return ApplyThunk<std_func_ptr, std::remove_const_t<R>,
+                    std::remove_const_t<Args>...>();
 }
 template <auto func_ptr, typename R, typename... Args>
 constexpr auto ResolveInvocable(R (*)(Args...)) {
-  return &DoApply<func_ptr, std::remove_const_t<R>,
-                  std::remove_const_t<Args>...>;
+  return ApplyThunk<func_ptr, std::remove_const_t<R>,
+                    std::remove_const_t<Args>...>();
 }
 
 template <auto mem_func_ptr, typename R, typename CT, typename... Args>
 constexpr auto ResolveInvocable(R (CT::*)(Args...)) {
-  return &DoApply<mem_func_ptr, std::remove_const_t<R>, std::remove_const_t<CT>,
-                  std::remove_const_t<Args>...>;
+  return ApplyThunk<mem_func_ptr, std::remove_const_t<R>,
+                    std::remove_const_t<CT>, std::remove_const_t<Args>...>();
 }
 template <auto mem_func_ptr, typename R, typename CT, typename... Args>
 constexpr auto ResolveInvocable(R (CT::*)(Args...) const) {
-  return &DoApply<mem_func_ptr, std::remove_const_t<R>, std::remove_const_t<CT>,
-                  std::remove_const_t<Args>...>;
+  return ApplyThunk<mem_func_ptr, std::remove_const_t<R>,
+                    std::remove_const_t<CT>, std::remove_const_t<Args>...>();
 }
 template <typename LambdaT, LambdaT *lambda_ptr, typename R, typename... Args>
 constexpr auto ResolveInvocableLambda(R (LambdaT::*)(Args...) const) {
-  return &DoApply<lambda_ptr, std::remove_const_t<R>,
-                  std::remove_const_t<Args>...>;
+  return ApplyThunk<lambda_ptr, std::remove_const_t<R>,
+                    std::remove_const_t<Args>...>();
 }
 
 /// mutable lambda
 template <typename LambdaT, LambdaT *lambda_ptr, typename R, typename... Args>
 constexpr auto ResolveInvocableLambda(R (LambdaT::*)(Args...)) {
-  return &DoApply<lambda_ptr, std::remove_const_t<R>,
-                  std::remove_const_t<Args>...>;
+  return ApplyThunk<lambda_ptr, std::remove_const_t<R>,
+                    std::remove_const_t<Args>...>();
 }
 template <auto lambda_ptr>
 constexpr auto ResolveInvocable(
@@ -168,14 +333,22 @@ inline constexpr auto DecayThenResolve() {
  * @return     function pointer to the thunk fuction
  */
 template <typename T>
-inline auto Import(T lambda) {
+CLCXX_HIDDEN inline auto Import(T lambda) {
   if constexpr (std::is_class_v<decltype(lambda())>) {
     static auto w = lambda();
     constexpr auto res = detail::DecayThenResolve<&w>();
-    return res;
+    if constexpr (res.signature != nullptr) {
+      detail::note_signature(reinterpret_cast<detail::FuncPtr>(res.thunk),
+                             res.signature);
+    }
+    return res.thunk;
   } else {
     constexpr auto res = detail::DecayThenResolve<lambda()>();
-    return res;
+    if constexpr (res.signature != nullptr) {
+      detail::note_signature(reinterpret_cast<detail::FuncPtr>(res.thunk),
+                             res.signature);
+    }
+    return res.thunk;
   }
 }
 
@@ -187,16 +360,40 @@ CLCXX_API char *str_append(char *old_str, const char *src);
 template <typename T>
 CLCXX_API void remove_c_strings(T obj);
 
+/// class thunks in the order of the package thunk table
+CLCXX_API std::vector<FuncPtr> class_thunks(const ClassInfo &c_info);
+
 // Base class to specialize for constructor
 template <typename CppT, typename... Args>
 CppT *CppConstructor(Args... args) {
-  auto obj_ptr = static_cast<CppT *>(
-      MemPool().allocate(sizeof(CppT), std::alignment_of_v<CppT>));
-  ::new (obj_ptr) CppT(args...);
+  auto obj_ptr = allocate_object<CppT>();
+  ::new (obj_ptr) CppT(std::forward<Args>(args)...);
   return obj_ptr;
 }
 
-using FuncPtr = void (*)();
+/// construct in caller memory of ClassInfo size and alignment
+template <typename CppT, typename... Args>
+void *CppConstructorAt(void *out, Args... args) {
+  if (reinterpret_cast<std::uintptr_t>(out) % alignof(CppT) != 0) {
+    throw std::runtime_error("Misaligned memory for " +
+                             std::string(TypeName<CppT>()));
+  }
+  ::new (out) CppT(std::forward<Args>(args)...);
+  return out;
+}
+
+/// pre-allocate n objects in the slab of T
+template <typename T>
+CLCXX_HIDDEN void ReserveObjects(size_t n) {
+  type_slab<T>().reserve(n);
+}
+
+/// destroy an object constructed in caller memory
+template <typename T>
+CLCXX_HIDDEN void destruct_obj_ptr(void *ptr) {
+  static_cast<T *>(ptr)->~T();
+}
+
 template <typename T, bool Constructor = true, typename... Args>
 struct CreateClass {
   inline FuncPtr operator()() {
@@ -210,11 +407,282 @@ struct CreateClass<T, false, Args...> {
   inline FuncPtr operator()() { return nullptr; }
 };
 
+template <typename T, auto accessor_ptr>
+CLCXX_HIDDEN void BufferThunk(void *obj, BufferInfo *out) {
+  try {
+    *out = std::invoke(*accessor_ptr, *static_cast<T *>(obj)).info;
+  } catch (const std::exception &err) {
+    LispError(err.what());
+  }
+}
+
+/// pod, complex and array members are copied as they are in snapshot
+/// buffers and gather columns, other members as their lisp representation
+template <typename MemberT>
+inline constexpr bool slot_raw_copy_v =
+    internal::is_pod_struct_v<MemberT> || internal::is_complex_v<MemberT> ||
+    std::is_array_v<MemberT>;
+
+template <typename MemberT>
+using slot_value_t =
+    std::conditional_t<slot_raw_copy_v<MemberT>, MemberT, ToLisp_t<MemberT>>;
+
+template <typename PM>
+struct member_pointer_traits;
+template <typename CT, typename MemberT>
+struct member_pointer_traits<MemberT CT::*> {
+  using member_type = MemberT;
+};
+
+/// locates a member given as template argument, e.g. member<&A::x>
+template <auto pm>
+struct FixedMember {
+  using type = typename member_pointer_traits<decltype(pm)>::member_type;
+  static constexpr auto pointer() { return pm; }
+};
+
+/// members of type MemberT bound with ClassWrapper::member(name, pm),
+/// their thunks read the member pointer from here by index
+template <typename CT, typename MemberT>
+struct IndexedMembers {
+  inline static MemberT CT::*pointers[CLCXX_MEMBERS_PER_TYPE] = {};
+  inline static size_t count = 0;
+
+  /// index of pm, CLCXX_MEMBERS_PER_TYPE when the table is full
+  static size_t index_of(MemberT CT::*pm) {
+    for (size_t i = 0; i < count; ++i) {
+      if (pointers[i] == pm) {
+        return i;
+      }
+    }
+    if (count == CLCXX_MEMBERS_PER_TYPE) {
+      return count;
+    }
+    pointers[count] = pm;
+    return count++;
+  }
+};
+
+template <typename CT, typename MemberT, size_t I>
+struct IndexedMember {
+  using type = MemberT;
+  static auto pointer() { return IndexedMembers<CT, MemberT>::pointers[I]; }
+};
+
+template <typename T, typename M>
+auto GetMember(const T &obj) -> const typename M::type {
+  return obj.*(M::pointer());
+}
+
+template <typename T, typename M>
+void SetMember(T &obj, const typename M::type val) {
+  obj.*(M::pointer()) = val;
+}
+
+/// copy one member of n objects into a column
+template <typename T, typename M>
+void GatherMember(void **objs, size_t n,
+                  slot_value_t<typename M::type> *out) {
+  for (size_t i = 0; i < n; ++i) {
+    const auto &obj = *static_cast<const T *>(objs[i]);
+    if constexpr (slot_raw_copy_v<typename M::type>) {
+      out[i] = obj.*(M::pointer());
+    } else {
+      out[i] = ToLisp<typename M::type>(obj.*(M::pointer()));
+    }
+  }
+}
+
+/// write a column back into one member of n objects
+template <typename T, typename M>
+void ScatterMember(void **objs, size_t n,
+                   const slot_value_t<typename M::type> *in) {
+  for (size_t i = 0; i < n; ++i) {
+    auto &obj = *static_cast<T *>(objs[i]);
+    if constexpr (slot_raw_copy_v<typename M::type>) {
+      obj.*(M::pointer()) = in[i];
+    } else {
+      obj.*(M::pointer()) = ToCpp<typename M::type>(in[i]);
+    }
+  }
+}
+
+/// copy a member into its snapshot slot
+template <typename T, typename M>
+void ReadSlot(const void *obj, char *dst) {
+  using MemberT = typename M::type;
+  const auto &member = static_cast<const T *>(obj)->*(M::pointer());
+  if constexpr (slot_raw_copy_v<MemberT>) {
+    std::memcpy(dst, std::addressof(member), sizeof(MemberT));
+  } else {
+    slot_value_t<MemberT> value = ToLisp<MemberT>(member);
+    std::memcpy(dst, &value, sizeof(value));
+  }
+}
+
+/// write a member back from its snapshot slot
+template <typename T, typename M>
+void WriteSlot(void *obj, const char *src) {
+  using MemberT = typename M::type;
+  auto &member = static_cast<T *>(obj)->*(M::pointer());
+  if constexpr (slot_raw_copy_v<MemberT>) {
+    std::memcpy(std::addressof(member), src, sizeof(MemberT));
+  } else {
+    slot_value_t<MemberT> value;
+    std::memcpy(&value, src, sizeof(value));
+    member = ToCpp<MemberT>(std::move(value));
+  }
+}
+
+/// a member in snapshot buffers, the package keeps one table per class
+struct SlotAccess {
+  size_t offset;
+  void (*read)(const void *obj, char *dst);
+  void (*write)(void *obj, const char *src);
+};
+
+/// copy all slots of the table into a flat buffer
+CLCXX_API void SnapshotSlots(const void *slot_table, void *obj, void *buffer);
+/// write back all slots of the table from a flat buffer
+CLCXX_API void RestoreSlots(const void *slot_table, void *obj,
+                            const void *buffer);
+
+/// iteration state of a range registered with ClassWrapper::iterator
+template <typename T>
+struct RangeCursor {
+  using iterator = decltype(std::begin(std::declval<T &>()));
+  iterator current;
+  iterator end;
+};
+
+template <typename T>
+using range_value_t =
+    std::remove_cv_t<std::remove_reference_t<decltype(*std::begin(
+        std::declval<T &>()))>>;
+
+template <typename T>
+struct is_pair : std::false_type {};
+template <typename T1, typename T2>
+struct is_pair<std::pair<T1, T2>> : std::true_type {};
+
+/// element layout in next-chunk buffers, same as gather columns:
+/// values for fundamentals and pods, pool allocated copies for classes
+template <typename E>
+using chunk_value_t = slot_value_t<std::remove_cv_t<E>>;
+
+template <typename E>
+chunk_value_t<E> chunk_value(const E &elem) {
+  if constexpr (slot_raw_copy_v<std::remove_cv_t<E>>) {
+    return elem;
+  } else {
+    return ToLisp<std::remove_cv_t<E>>(elem);
+  }
+}
+
+template <typename T>
+void *BeginRange(T &range) {
+  return new RangeCursor<T>{std::begin(range), std::end(range)};
+}
+
+template <typename T>
+void EndRange(void *cursor) {
+  delete static_cast<RangeCursor<T> *>(cursor);
+}
+
+/// convert up to n elements into out, returns the number of elements written
+template <typename T>
+size_t NextChunk(void *cursor, size_t n,
+                 chunk_value_t<range_value_t<T>> *out) {
+  auto &c = *static_cast<RangeCursor<T> *>(cursor);
+  size_t i = 0;
+  for (; i < n && c.current != c.end; ++i, ++c.current) {
+    out[i] = chunk_value(*c.current);
+  }
+  return i;
+}
+
+/// map like ranges fill separate key and value buffers
+template <typename T>
+size_t NextChunkPairs(
+    void *cursor, size_t n,
+    chunk_value_t<typename range_value_t<T>::first_type> *keys,
+    chunk_value_t<typename range_value_t<T>::second_type> *values) {
+  auto &c = *static_cast<RangeCursor<T> *>(cursor);
+  size_t i = 0;
+  for (; i < n && c.current != c.end; ++i, ++c.current) {
+    keys[i] = chunk_value(c.current->first);
+    values[i] = chunk_value(c.current->second);
+  }
+  return i;
+}
+
+/// column value converted back to C++, see chunk_value
+template <typename E>
+decltype(auto) cpp_value(const chunk_value_t<E> &val) {
+  if constexpr (slot_raw_copy_v<E>) {
+    return val;
+  } else {
+    return ToCpp<E>(val);
+  }
+}
+
+/// key used for lookups, string keys reuse one buffer per thread instead
+/// of allocating a std::string for each key
+template <typename K>
+const K &lookup_key(const chunk_value_t<K> &key) {
+  if constexpr (internal::is_std_string_v<K>) {
+    thread_local std::string buffer;
+    buffer.assign(key);
+    return buffer;
+  } else if constexpr (std::is_same_v<chunk_value_t<K>, K>) {
+    return key;
+  } else {
+    static_assert(internal::is_general_class_v<K>, "Unsupported map key type");
+    return ToCpp<K>(key);
+  }
+}
+
+template <typename T>
+using map_key_t = typename T::key_type;
+template <typename T>
+using map_value_t = typename T::mapped_type;
+
+/// look up n keys, found[i] tells whether values[i] was written
+template <typename T>
+void MapFind(const T &map, const chunk_value_t<map_key_t<T>> *keys, size_t n,
+             chunk_value_t<map_value_t<T>> *values, bool *found) {
+  for (size_t i = 0; i < n; ++i) {
+    auto iter = map.find(lookup_key<map_key_t<T>>(keys[i]));
+    found[i] = iter != map.end();
+    if (found[i]) values[i] = chunk_value(iter->second);
+  }
+}
+
+/// insert or assign n key/value pairs
+template <typename T>
+void MapInsert(T &map, const chunk_value_t<map_key_t<T>> *keys,
+               const chunk_value_t<map_value_t<T>> *values, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    map.insert_or_assign(lookup_key<map_key_t<T>>(keys[i]),
+                         cpp_value<map_value_t<T>>(values[i]));
+  }
+}
+
+/// erase n keys, returns the number of erased elements
+template <typename T>
+size_t MapErase(T &map, const chunk_value_t<map_key_t<T>> *keys, size_t n) {
+  size_t erased = 0;
+  for (size_t i = 0; i < n; ++i) {
+    erased += map.erase(lookup_key<map_key_t<T>>(keys[i]));
+  }
+  return erased;
+}
+
 template <typename T>
-void free_obj_ptr(void *ptr) {
+CLCXX_HIDDEN void free_obj_ptr(void *ptr) {
   auto obj_ptr = static_cast<T *>(ptr);
   obj_ptr->~T();
-  MemPool().deallocate(ptr, sizeof(T), std::alignment_of_v<T>);
+  deallocate_object<T>(ptr);
 }
 
 /// handle POD class
@@ -231,10 +699,20 @@ std::string arg_type_pod_fix() {
   return return_type;
 }
 
+/// large POD structs are passed by const pointer
+template <typename CppT>
+std::string arg_type_string() {
+  if constexpr (internal::is_large_pod_struct_v<std::remove_cv_t<CppT>>) {
+    return "(:const-reference " + arg_type_pod_fix<CppT>() + ")";
+  } else {
+    return arg_type_pod_fix<CppT>();
+  }
+}
+
 /// Make a string with the types in the variadic template parameter pack
 template <typename... Args>
 std::string arg_types_string() {
-  std::vector<std::string> vec = {arg_type_pod_fix<Args>()...};
+  std::vector<std::string> vec = {arg_type_string<Args>()...};
   std::string s;
   for (auto arg_types : vec) {
     s.append(arg_types);
@@ -243,6 +721,217 @@ std::string arg_types_string() {
   return s;
 }
 
+template <typename T, typename CT, typename MemberT>
+std::ptrdiff_t offset_in(const T &obj, MemberT CT::*pm) {
+  return reinterpret_cast<const char *>(std::addressof(obj.*pm)) -
+         reinterpret_cast<const char *>(std::addressof(obj));
+}
+
+/// offset of a member inside T, measured on a live object at registration:
+/// a default constructed one, or for trivially copyable types the object
+/// implicitly created by operator new. -1 if T isn't standard layout or
+/// has no such object
+template <typename T, typename CT, typename MemberT>
+std::ptrdiff_t member_offset(MemberT CT::*pm) {
+  if constexpr (!std::is_standard_layout_v<T>) {
+    return -1;
+  } else if constexpr (std::is_trivially_copyable_v<T>) {
+    const auto storage =
+        ::operator new(sizeof(T), std::align_val_t(alignof(T)));
+    const auto offset = offset_in(*static_cast<const T *>(storage), pm);
+    ::operator delete(storage, std::align_val_t(alignof(T)));
+    return offset;
+  } else if constexpr (std::is_default_constructible_v<T>) {
+    const T obj{};
+    return offset_in(obj, pm);
+  } else {
+    return -1;
+  }
+}
+
+/// append member name, type, offset, size and alignment to slots
+template <typename T, typename CT, typename MemberT>
+void append_slot(ClassInfo &c_info, const std::string &name,
+                 MemberT CT::*pm) {
+  static_assert(std::is_base_of<CT, T>::value,
+                "member() requires a class member (or base class member)");
+  c_info.slot_types = str_append(c_info.slot_types,
+                                 std::string(LispType<MemberT>() + "+").c_str());
+  c_info.slot_names =
+      str_append(c_info.slot_names, std::string(name + "+").c_str());
+  c_info.slot_offsets = str_append(
+      c_info.slot_offsets,
+      std::string(std::to_string(member_offset<T>(pm)) + "+").c_str());
+  c_info.slot_sizes = str_append(
+      c_info.slot_sizes,
+      std::string(std::to_string(sizeof(MemberT)) + "+").c_str());
+  c_info.slot_alignments = str_append(
+      c_info.slot_alignments,
+      std::string(std::to_string(alignof(MemberT)) + "+").c_str());
+}
+
+/// argument categories of overloaded functions, each one has a single
+/// lisp representation in the argument array of the dispatcher
+enum class ArgCode : uint64_t {
+  integer = 1,  // int64_t
+  real = 2,     // double
+  boolean = 3,  // bool
+  string = 4,   // const char *
+  object = 5,   // void *, classes, pointers and references
+  pod = 6       // the struct itself
+};
+
+template <typename T>
+constexpr ArgCode arg_code() {
+  using U = std::remove_cv_t<std::remove_reference_t<T>>;
+  if constexpr (std::is_same_v<U, bool>) {
+    return ArgCode::boolean;
+  } else if constexpr (std::is_integral_v<U> || std::is_enum_v<U>) {
+    return ArgCode::integer;
+  } else if constexpr (std::is_floating_point_v<U>) {
+    return ArgCode::real;
+  } else if constexpr (std::is_same_v<U, const char *> ||
+                       internal::is_std_string_v<U> ||
+                       internal::is_string_view_v<U>) {
+    return ArgCode::string;
+  } else if constexpr (internal::is_pod_struct_v<U> &&
+                       !std::is_reference_v<T>) {
+    return ArgCode::pod;
+  } else {
+    static_assert(std::is_pointer_v<U> || std::is_reference_v<T> ||
+                      internal::is_general_class_v<U> ||
+                      internal::is_pod_struct_v<U>,
+                  "Unsupported overloaded argument type");
+    return ArgCode::object;
+  }
+}
+
+/// tag of an overload: arity in the low 4 bits then 3 bits per argument
+/// code, lisp computes the same tag from the types of its arguments
+template <typename... Args>
+constexpr uint64_t overload_tag() {
+  static_assert(sizeof...(Args) <= 15, "Too many overloaded arguments");
+  uint64_t tag = sizeof...(Args);
+  unsigned shift = 4;
+  ((tag |= static_cast<uint64_t>(arg_code<Args>()) << shift, shift += 3), ...);
+  return tag;
+}
+
+template <typename T>
+decltype(auto) overload_arg(void *arg) {
+  using U = std::remove_cv_t<std::remove_reference_t<T>>;
+  constexpr auto code = arg_code<T>();
+  if constexpr (code == ArgCode::integer || code == ArgCode::real) {
+    using LispT = std::conditional_t<code == ArgCode::integer, int64_t, double>;
+    return static_cast<U>(*static_cast<LispT *>(arg));
+  } else if constexpr (code == ArgCode::boolean) {
+    return *static_cast<bool *>(arg);
+  } else if constexpr (code == ArgCode::string) {
+    auto str = *static_cast<const char **>(arg);
+    if constexpr (std::is_same_v<U, const char *>) {
+      return str;
+    } else {
+      return U(str);
+    }
+  } else if constexpr (code == ArgCode::pod) {
+    return *static_cast<U *>(arg);
+  } else {
+    return ToCpp<T>(*static_cast<ToLisp_t<T> *>(arg));
+  }
+}
+
+template <typename F>
+struct overload_traits;
+template <typename R, typename... Args>
+struct overload_traits<R (*)(Args...)> {
+  using return_type = std::remove_cv_t<R>;
+  static constexpr uint64_t tag = overload_tag<Args...>();
+
+  template <auto func, size_t... I>
+  static void call(void **args, void *result, std::index_sequence<I...>) {
+    static_assert(!internal::is_out_return_v<return_type>,
+                  "Overloads can't return large pods or placed results");
+    if constexpr (std::is_void_v<return_type>) {
+      func(overload_arg<Args>(args[I])...);
+    } else {
+      *static_cast<ToLisp_t<return_type> *>(result) =
+          ToLisp<return_type>(func(overload_arg<Args>(args[I])...));
+    }
+  }
+};
+
+template <auto func>
+void CallOverload(void **args, void *result) {
+  using traits = overload_traits<decltype(func)>;
+  constexpr auto arity = traits::tag & 0xF;
+  traits::template call<func>(args, result, std::make_index_sequence<arity>());
+}
+
+template <auto... funcs>
+constexpr bool unique_overload_tags() {
+  constexpr uint64_t tags[] = {overload_traits<decltype(funcs)>::tag...};
+  for (size_t i = 0; i < sizeof...(funcs); ++i)
+    for (size_t j = i + 1; j < sizeof...(funcs); ++j)
+      if (tags[i] == tags[j]) return false;
+  return true;
+}
+
+struct OverloadEntry {
+  uint64_t tag;
+  void (*call)(void **args, void *result);
+};
+
+/// overloads sorted by tag at compile time
+template <auto... funcs>
+constexpr std::array<OverloadEntry, sizeof...(funcs)> sorted_overloads() {
+  std::array<OverloadEntry, sizeof...(funcs)> entries = {
+      OverloadEntry{overload_traits<decltype(funcs)>::tag,
+                    &CallOverload<funcs>}...};
+  for (size_t i = 1; i < entries.size(); ++i) {
+    for (size_t j = i; j > 0 && entries[j].tag < entries[j - 1].tag; --j) {
+      const auto entry = entries[j];
+      entries[j] = entries[j - 1];
+      entries[j - 1] = entry;
+    }
+  }
+  return entries;
+}
+
+/// single thunk for several overloads: args[i] points to the lisp value of
+/// argument i and the result is written to result
+template <auto... funcs>
+CLCXX_HIDDEN void DispatchOverload(uint64_t tag, void **args, void *result) {
+  static_assert(unique_overload_tags<funcs...>(),
+                "Overloads should differ in the argument codes");
+  static constexpr auto entries = sorted_overloads<funcs...>();
+  try {
+    const auto entry = std::lower_bound(
+        entries.begin(), entries.end(), tag,
+        [](const OverloadEntry &e, uint64_t t) { return e.tag < t; });
+    if (entry != entries.end() && entry->tag == tag) {
+      entry->call(args, result);
+      return;
+    }
+    throw std::runtime_error("No overload for argument tag " +
+                             std::to_string(tag));
+  } catch (const std::exception &err) {
+    LispError(err.what());
+  }
+}
+
+template <auto... funcs>
+std::string overload_tags_string() {
+  return ((std::to_string(overload_traits<decltype(funcs)>::tag) + "+") + ...);
+}
+
+template <auto... funcs>
+std::string overload_return_types_string() {
+  return ((arg_type_pod_fix<
+               typename overload_traits<decltype(funcs)>::return_type>() +
+           "+") +
+          ...);
+}
+
 /// Make a string with the super classes in the variadic template parameter
 /// pack
 template <typename... Args>
@@ -255,6 +944,62 @@ std::string super_classes_string() {
   }
   return s;
 }
+
+/// Base* can be cast down to T*, false for virtual and ambiguous bases
+template <typename Base, typename T, typename = void>
+struct is_static_downcastable : std::false_type {};
+template <typename Base, typename T>
+struct is_static_downcastable<
+    Base, T, std::void_t<decltype(static_cast<T *>(std::declval<Base *>()))>>
+    : std::true_type {};
+
+/// byte offset of the Base subobject, fixed for non virtual bases,
+/// measured on a live object when T can be default constructed
+template <typename T, typename Base>
+std::ptrdiff_t base_offset() {
+  static_assert(std::is_base_of_v<Base, T>,
+                "super classes should be base classes");
+  static_assert(is_static_downcastable<Base, T>::value,
+                "super classes should be non virtual, unambiguous bases");
+  const auto offset = [](const T &obj) {
+    return reinterpret_cast<const char *>(static_cast<const Base *>(&obj)) -
+           reinterpret_cast<const char *>(&obj);
+  };
+  if constexpr (std::is_default_constructible_v<T> &&
+                !std::is_abstract_v<T>) {
+    const T obj{};
+    return offset(obj);
+  } else {
+    // a non virtual base lies at the same offset in every T
+    alignas(T) static const unsigned char storage[sizeof(T)] = {};
+    return offset(*reinterpret_cast<const T *>(storage));
+  }
+}
+
+/// upcast adjustments in the order of super_classes_string
+template <typename T, typename... Args>
+std::string super_offsets_string() {
+  return ((std::to_string(base_offset<T, Args>()) + "+") + ... + std::string());
+}
+
+/// typeid of registered classes to their index in the package classes
+using ClassIndexes = std::unordered_map<std::type_index, int64_t>;
+
+/// class index of the dynamic type of obj in the package of class_indexes,
+/// -1 if it isn't registered there;
+/// most_derived (if not null) gets the pointer to the complete object
+template <typename T>
+CLCXX_HIDDEN int64_t DynamicClass(const void *class_indexes, void *obj,
+                                  void **most_derived) {
+  if (obj == nullptr) return -1;
+  auto cpp_obj = static_cast<T *>(obj);
+  if (most_derived != nullptr) {
+    *most_derived = dynamic_cast<void *>(cpp_obj);
+  }
+  const auto &indexes = *static_cast<const ClassIndexes *>(class_indexes);
+  const auto iter = indexes.find(std::type_index(typeid(*cpp_obj)));
+  return iter == indexes.end() ? -1 : iter->second;
+}
 }  // namespace detail
 
 /// Registry containing different packages
@@ -281,6 +1026,9 @@ class CLCXX_API PackageRegistry {
   using Iter = std::map<std::string, std::shared_ptr<Package>>::iterator;
   [[nodiscard]] Iter remove_package(Iter iter);
 
+  /// packed signature of a thunk in any registered package
+  const detail::PackedSignature *find_signature(detail::FuncPtr thunk) const;
+
   bool has_current_package() { return p_current_package != nullptr; }
   Package &current_package();
   void reset_current_package() { p_current_package = nullptr; }
@@ -352,12 +1100,46 @@ class CLCXX_API Package {
 
     ClassInfo c_info;
     c_info.constructor = detail::CreateClass<T, Constructor>()();
+    c_info.constructors = nullptr;
     c_info.destructor = reinterpret_cast<void (*)()>(detail::free_obj_ptr<T>);
+    c_info.destruct =
+        reinterpret_cast<void (*)()>(detail::destruct_obj_ptr<T>);
+    c_info.size = sizeof(T);
+    c_info.alignment = alignof(T);
+    c_info.reserve = nullptr;
+    c_info.buffer_type = nullptr;
+    c_info.buffer = nullptr;
+    c_info.snapshot = reinterpret_cast<void (*)()>(&detail::SnapshotSlots);
+    c_info.restore = reinterpret_cast<void (*)()>(&detail::RestoreSlots);
+    auto &slots = p_slot_tables[name];
+    slots.clear();
+    c_info.slot_table = &slots;
+    c_info.snapshot_size = 0;
+    c_info.snapshot_offsets = nullptr;
     c_info.slot_types = nullptr;
     c_info.slot_names = nullptr;
+    c_info.slot_offsets = nullptr;
+    c_info.slot_sizes = nullptr;
+    c_info.slot_alignments = nullptr;
     c_info.name = detail::str_dup(name.c_str());
     c_info.super_classes =
         detail::str_dup(detail::super_classes_string<s_classes...>().c_str());
+    c_info.super_offsets = detail::str_dup(
+        detail::super_offsets_string<T, s_classes...>().c_str());
+    if constexpr (std::is_polymorphic_v<T>) {
+      c_info.dynamic_class =
+          reinterpret_cast<void (*)()>(&detail::DynamicClass<T>);
+    } else {
+      c_info.dynamic_class = nullptr;
+    }
+    if constexpr (CLCXX_CHECKED_HANDLES != 0) {
+      (detail::register_handle_base(
+           static_cast<uint32_t>(Hash32TypeName<T>()),
+           static_cast<uint32_t>(Hash32TypeName<s_classes>())),
+       ...);
+    }
+    p_class_indexes[std::type_index(typeid(T))] =
+        static_cast<int64_t>(p_classes_meta_data.size());
     // Store data
     p_classes_meta_data.push_back(c_info);
     return ClassWrapper<T>(*this);
@@ -379,16 +1161,55 @@ class CLCXX_API Package {
 
     ClassInfo c_info;
     c_info.constructor = nullptr;
+    c_info.constructors = nullptr;
     c_info.destructor = nullptr;
+    c_info.destruct = nullptr;
+    c_info.size = sizeof(T);
+    c_info.alignment = alignof(T);
+    c_info.reserve = nullptr;
+    c_info.buffer_type = nullptr;
+    c_info.buffer = nullptr;
+    c_info.snapshot = nullptr;
+    c_info.restore = nullptr;
+    c_info.slot_table = nullptr;
+    c_info.snapshot_size = 0;
+    c_info.snapshot_offsets = nullptr;
     c_info.slot_types = nullptr;
     c_info.slot_names = nullptr;
+    c_info.slot_offsets = nullptr;
+    c_info.slot_sizes = nullptr;
+    c_info.slot_alignments = nullptr;
     c_info.name = detail::str_dup(name.c_str());
     c_info.super_classes = nullptr;
+    c_info.super_offsets = nullptr;
+    c_info.dynamic_class = nullptr;
     // Store data
     p_classes_meta_data.push_back(c_info);
     return PodClassWrapper<T>(*this);
   }
 
+  /// Register free functions under one name with a single dispatcher thunk
+  /// e.g. defoverload<static_cast<int (*)(int)>(&f), &g>("f")
+  template <auto... funcs>
+  void defoverload(const std::string &name) {
+    static_assert(sizeof...(funcs) > 0, "defoverload needs a function");
+    FunctionInfo f_info;
+    f_info.name = detail::str_dup(name.c_str());
+    f_info.method_p = false;
+    f_info.class_obj = detail::str_dup("");
+    f_info.func_ptr =
+        reinterpret_cast<void (*)()>(&detail::DispatchOverload<funcs...>);
+    f_info.arg_types = detail::str_dup(
+        detail::arg_types_string<uint64_t, void **, void *>().c_str());
+    f_info.return_type = detail::str_dup(LispType<void>().c_str());
+    f_info.out_return_p = false;
+    f_info.overload_tags =
+        detail::str_dup(detail::overload_tags_string<funcs...>().c_str());
+    f_info.overload_return_types = detail::str_dup(
+        detail::overload_return_types_string<funcs...>().c_str());
+    p_functions_meta_data.push_back(f_info);
+  }
+
   /// Set a global constant value at the package level
   template <typename T>
   void defconstant(const std::string &name, T &&value) {
@@ -414,11 +1235,47 @@ class CLCXX_API Package {
   }
   std::vector<ConstantInfo> &constants_meta_data() { return p_constants; }
 
+  /// Build the thunk table from the meta data:
+  /// class thunks (detail::class_thunks) then functions in definition order
+  void collect_thunks();
+  const std::vector<detail::FuncPtr> &thunks() const { return p_thunks; }
+
+  /// record the packed signature of a thunk of the package
+  void add_packed_signature(detail::FuncPtr thunk,
+                            detail::SignatureGetter signature) {
+    p_signatures.emplace(thunk, signature);
+  }
+
+  /// nullptr if the thunk has no packed signature in this package
+  const detail::PackedSignature *packed_signature(
+      detail::FuncPtr thunk) const {
+    auto iter = p_signatures.find(thunk);
+    return iter == p_signatures.end() ? nullptr : &iter->second();
+  }
+
+  /// first argument of the dynamic_class thunks of the package classes
+  const detail::ClassIndexes &class_indexes() const { return p_class_indexes; }
+
+  /// slot table of a class for its snapshot and restore thunks,
+  /// null if the class isn't defined in the package
+  const std::vector<detail::SlotAccess> *slot_table(
+      const std::string &class_name) const {
+    auto iter = p_slot_tables.find(class_name);
+    return iter == p_slot_tables.end() ? nullptr : &iter->second;
+  }
+
+  /// pre-allocation function of a class with a slab, null otherwise
+  void (*reserve_function(const std::string &class_name) const)(size_t) {
+    auto iter = p_reserve_functions.find(class_name);
+    return iter == p_reserve_functions.end() ? nullptr : iter->second;
+  }
+
  private:
-  /// Define a new function
+  /// Record a function of signature R(Args...), the callable itself is
+  /// only reached through its thunk func_ptr
   template <typename R, typename... Args>
-  void defun(const std::string &name, std::function<R(Args...)>, bool is_method,
-             const char *class_name, void (*func_ptr)()) {
+  void add_signature(const std::string &name, bool is_method,
+                     const char *class_name, void (*func_ptr)()) {
     FunctionInfo f_info;
     f_info.name = detail::str_dup(name.c_str());
     f_info.method_p = is_method;
@@ -427,50 +1284,55 @@ class CLCXX_API Package {
     f_info.arg_types =
         detail::str_dup(detail::arg_types_string<Args...>().c_str());
     f_info.return_type = detail::str_dup(detail::arg_type_pod_fix<R>().c_str());
+    f_info.out_return_p = internal::is_out_return_v<R>;
+    f_info.overload_tags = nullptr;
+    f_info.overload_return_types = nullptr;
     // store data
     p_functions_meta_data.push_back(f_info);
   }
 
   /// Define a new function. Overload for pointers
   template <typename R, typename... Args>
-  void defun(const std::string &name, R (*f)(Args...), bool is_method,
+  void defun(const std::string &name, R (*)(Args...), bool is_method,
              const char *class_name, void (*func_ptr)()) {
-    defun(name, std::function<R(Args...)>(f), is_method, class_name, func_ptr);
+    add_signature<R, Args...>(name, is_method, class_name, func_ptr);
   }
 
-  /// Define a new function. Overload for lambda
+  /// Define a new function. Overload for lambda and std::function
   template <typename LambdaT>
-  void defun(const std::string &name, LambdaT &&lambda, bool is_method,
-             const char *class_name, void (*func_ptr)()  // ,
-             // std::enable_if_t<!std::is_member_function_pointer_v<LambdaT>,
-             //                  bool> = true
-  ) {
-    static_assert(!std::is_member_function_pointer_v<LambdaT>,
+  void defun(const std::string &name, LambdaT &&, bool is_method,
+             const char *class_name, void (*func_ptr)()) {
+    using ClassT = std::remove_reference_t<LambdaT>;
+    static_assert(!std::is_member_function_pointer_v<ClassT>,
                   "Use defmethod for member functions");
-    add_lambda(name, std::forward<LambdaT>(lambda), &LambdaT::operator(),
-               is_method, class_name, func_ptr);
+    add_lambda(name, &ClassT::operator(), is_method, class_name, func_ptr);
   }
 
   template <typename R, typename LambdaT, typename... ArgsT>
-  void add_lambda(const std::string &name, LambdaT &&lambda,
-                  R (LambdaT::*)(ArgsT...) const, bool is_method,
-                  const char *class_name, void (*func_ptr)()) {
-    defun(name, std::function<R(ArgsT...)>(std::forward<LambdaT>(lambda)),
-          is_method, class_name, func_ptr);
+  void add_lambda(const std::string &name, R (LambdaT::*)(ArgsT...) const,
+                  bool is_method, const char *class_name,
+                  void (*func_ptr)()) {
+    add_signature<R, ArgsT...>(name, is_method, class_name, func_ptr);
   }
 
   template <typename R, typename LambdaT, typename... ArgsT>
-  void add_lambda(const std::string &name, LambdaT &&lambda,
-                  R (LambdaT::*)(ArgsT...), bool is_method,
-                  const char *class_name, void (*func_ptr)()) {
-    defun(name, std::function<R(ArgsT...)>(std::forward<LambdaT>(lambda)),
-          is_method, class_name, func_ptr);
+  void add_lambda(const std::string &name, R (LambdaT::*)(ArgsT...),
+                  bool is_method, const char *class_name,
+                  void (*func_ptr)()) {
+    add_signature<R, ArgsT...>(name, is_method, class_name, func_ptr);
   }
 
   std::string p_cl_pack;
   std::vector<ClassInfo> p_classes_meta_data;
   std::vector<FunctionInfo> p_functions_meta_data;
   std::vector<ConstantInfo> p_constants;
+  std::vector<detail::FuncPtr> p_thunks;
+  // thunks imported during registration that can run asynchronously
+  std::unordered_map<detail::FuncPtr, detail::SignatureGetter> p_signatures;
+  // kept after the meta data is released, lisp holds pointers to them
+  std::map<std::string, std::vector<detail::SlotAccess>> p_slot_tables;
+  std::map<std::string, void (*)(size_t)> p_reserve_functions;
+  detail::ClassIndexes p_class_indexes;
   std::unordered_map<SizeT, std::string> general_class_name;
   std::unordered_map<SizeT, std::string> pod_class_name;
   template <class T>
@@ -499,16 +1361,9 @@ class PodClassWrapper {
 
  private:
   template <typename CT, typename MemberT>
-  constexpr void check_member_and_append_its_slots(const std::string &name,
-                                                   MemberT CT::*) {
-    static_assert(std::is_base_of<CT, T>::value,
-                  "member() requires a class member (or base class member)");
-    auto &curr_class = p_package.p_classes_meta_data.back();
-
-    curr_class.slot_types = detail::str_append(
-        curr_class.slot_types, std::string(LispType<MemberT>() + "+").c_str());
-    curr_class.slot_names = detail::str_append(curr_class.slot_names,
-                                               std::string(name + "+").c_str());
+  void check_member_and_append_its_slots(const std::string &name,
+                                         MemberT CT::*pm) {
+    detail::append_slot<T>(p_package.p_classes_meta_data.back(), name, pm);
   }
 
   Package &p_package;
@@ -533,6 +1388,10 @@ class ClassWrapper {
 
     p_package.defun(name, F_PTR(detail::CppConstructor<T, Args...>), false,
                     curr_class.name);
+    curr_class.constructors = detail::str_append(
+        curr_class.constructors, std::string(name + "+").c_str());
+    p_package.defun(name + "-at", F_PTR(detail::CppConstructorAt<T, Args...>),
+                    false, curr_class.name);
     return *this;
   }
 
@@ -545,13 +1404,92 @@ class ClassWrapper {
   }
 
   // Add public member >> readwrite
+  // up to CLCXX_MEMBERS_PER_TYPE members of one type can be added this way,
+  // member<&T::m>(name) has no such limit
   template <typename CT, typename MemberT>
   ClassWrapper<T> &member(const std::string &name, MemberT CT::*pm) {
-    check_member_and_append_its_slots(name, pm);
-    defmethod(std::string(name + ".get"),
-              F_PTR([pm](const T &c) -> const MemberT { return c.*pm; }));
-    defmethod(std::string(name + ".set"),
-              F_PTR([pm](T &c, const MemberT val) { c.*pm = val; }));
+    const auto index = detail::IndexedMembers<CT, MemberT>::index_of(pm);
+    if (index == CLCXX_MEMBERS_PER_TYPE) {
+      throw std::runtime_error(
+          "Member " + name +
+          " exceeds CLCXX_MEMBERS_PER_TYPE members of its type, use "
+          "member<&Class::" +
+          name + ">(\"" + name + "\")");
+    }
+    add_indexed_member(name, pm, index,
+                       std::make_index_sequence<CLCXX_MEMBERS_PER_TYPE>());
+    return *this;
+  }
+
+  // Add public member >> readwrite, e.g. member<&A::x>("x")
+  template <auto pm>
+  ClassWrapper<T> &member(const std::string &name) {
+    add_member<detail::FixedMember<pm>>(name, pm);
+    return *this;
+  }
+
+  /// Iterate over a range class from lisp in chunks
+  /// name.begin: (range) -> cursor, name.end: (cursor) frees it
+  /// name.next-chunk: (cursor, n, out) -> count, or (cursor, n, keys, values)
+  /// for ranges of pairs such as std::map
+  ClassWrapper<T> &iterator(const std::string &name = "iter") {
+    defmethod(std::string(name + ".begin"), F_PTR(&detail::BeginRange<T>));
+    defstatic(std::string(name + ".end"), F_PTR(&detail::EndRange<T>));
+    if constexpr (detail::is_pair<detail::range_value_t<T>>::value) {
+      defstatic(std::string(name + ".next-chunk"),
+                F_PTR(&detail::NextChunkPairs<T>));
+    } else {
+      defstatic(std::string(name + ".next-chunk"),
+                F_PTR(&detail::NextChunk<T>));
+    }
+    return *this;
+  }
+
+  /// Batched lookup, insert and erase for associative containers
+  /// name.find: (map, keys, n, values, found)
+  /// name.insert: (map, keys, values, n), name.erase: (map, keys, n) -> count
+  ClassWrapper<T> &defmap(const std::string &name = "map") {
+    defmethod(std::string(name + ".find"), F_PTR(&detail::MapFind<T>));
+    defmethod(std::string(name + ".insert"), F_PTR(&detail::MapInsert<T>));
+    defmethod(std::string(name + ".erase"), F_PTR(&detail::MapErase<T>));
+    return *this;
+  }
+
+  /// Allocate objects of this class from their own slab instead of the
+  /// shared pool, call it before any object is handed to lisp.
+  /// The slab is shared by every package binding T.
+  ClassWrapper<T> &slab() {
+    if (object_resource<T>() != &type_slab<T>()) {
+      if (live_objects<T>().load() != 0) {
+        throw std::runtime_error(
+            "Class " + std::string(TypeName<T>()) +
+            " has live objects in the shared pool, call slab() first");
+      }
+      object_resource<T>() = &type_slab<T>();
+    }
+    auto &c_info = p_package.p_classes_meta_data.back();
+    c_info.reserve = reinterpret_cast<void (*)()>(&detail::ReserveObjects<T>);
+    p_package.p_reserve_functions[c_info.name] = &detail::ReserveObjects<T>;
+    return *this;
+  }
+
+  /// Expose object storage through the buffer protocol
+  /// accessor: [](T &obj) { return clcxx::Buffer<ElemT>(data, shape, strides); }
+  template <typename LambdaT>
+  ClassWrapper<T> &buffer(LambdaT &&accessor) {
+    using BufferT = std::invoke_result_t<LambdaT, T &>;
+    using ElemT = typename BufferT::value_type;
+    static_assert(std::is_same_v<BufferT, Buffer<ElemT>>,
+                  "buffer() accessor should return clcxx::Buffer<T>");
+    static auto w = std::forward<LambdaT>(accessor);
+    auto &curr_class = p_package.p_classes_meta_data.back();
+    if (curr_class.buffer != nullptr) {
+      throw std::runtime_error("Class " + std::string(curr_class.name) +
+                               " already has a buffer accessor");
+    }
+    curr_class.buffer_type = detail::str_dup(LispType<ElemT>().c_str());
+    curr_class.buffer =
+        reinterpret_cast<void (*)()>(&detail::BufferThunk<T, &w>);
     return *this;
   }
 
@@ -560,37 +1498,27 @@ class ClassWrapper {
 
  private:
   template <typename CT, typename MemberT>
-  constexpr void check_member_and_append_its_slots(const std::string &name,
-                                                   MemberT CT::*) {
-    static_assert(std::is_base_of<CT, T>::value,
-                  "member() requires a class member (or base class member)");
-    auto &curr_class = p_package.p_classes_meta_data.back();
-
-    curr_class.slot_types = detail::str_append(
-        curr_class.slot_types, std::string(LispType<MemberT>() + "+").c_str());
-    curr_class.slot_names = detail::str_append(curr_class.slot_names,
-                                               std::string(name + "+").c_str());
+  void check_member_and_append_its_slots(const std::string &name,
+                                         MemberT CT::*pm) {
+    detail::append_slot<T>(p_package.p_classes_meta_data.back(), name, pm);
   }
 
-  /// Define a member function
+  /// Define a member function, the object is the first argument
   template <typename R, typename CT, typename... ArgsT>
-  void defmethod(const std::string &name, R (CT::*f)(ArgsT...),
+  void defmethod(const std::string &name, R (CT::*)(ArgsT...),
                  void (*func_ptr)()) {
     auto curr_class = p_package.p_classes_meta_data.back();
-    p_package.defun(
-        name, [f](T &obj, ArgsT... args) -> R { return (obj.*f)(args...); },
-        true, curr_class.name, func_ptr);
+    p_package.add_signature<R, T &, ArgsT...>(name, true, curr_class.name,
+                                              func_ptr);
   }
 
   /// Define a member function, const version
   template <typename R, typename CT, typename... ArgsT>
-  void defmethod(const std::string &name, R (CT::*f)(ArgsT...) const,
+  void defmethod(const std::string &name, R (CT::*)(ArgsT...) const,
                  void (*func_ptr)()) {
     auto curr_class = p_package.p_classes_meta_data.back();
-    p_package.defun(
-        name,
-        [f](const T &obj, ArgsT... args) -> R { return (obj.*f)(args...); },
-        true, curr_class.name, func_ptr);
+    p_package.add_signature<R, const T &, ArgsT...>(name, true,
+                                                    curr_class.name, func_ptr);
   }
 
   /// Define a "member" function using a lambda
@@ -604,6 +1532,52 @@ class ClassWrapper {
                     func_ptr);
   }
 
+  /// function of this class without an object argument
+  template <typename FuncT>
+  void defstatic(const std::string &name, void (*func_ptr)(), FuncT &&functor) {
+    auto curr_class = p_package.p_classes_meta_data.back();
+    p_package.defun(name, func_ptr, std::forward<FuncT>(functor), false,
+                    curr_class.name);
+  }
+
+  /// add the thunks of the member at index of its type table
+  template <typename CT, typename MemberT, size_t... I>
+  void add_indexed_member(const std::string &name, MemberT CT::*pm,
+                          size_t index, std::index_sequence<I...>) {
+    ((I == index
+          ? add_member<detail::IndexedMember<CT, MemberT, I>>(name, pm)
+          : void()),
+     ...);
+  }
+
+  /// member accessors with M locating the member
+  template <typename M, typename CT, typename MemberT>
+  void add_member(const std::string &name, MemberT CT::*pm) {
+    check_member_and_append_its_slots(name, pm);
+    append_snapshot_slot<M>();
+    defmethod(std::string(name + ".get"), F_PTR(&detail::GetMember<T, M>));
+    defmethod(std::string(name + ".set"), F_PTR(&detail::SetMember<T, M>));
+    defstatic(std::string(name + ".gather"),
+              F_PTR(&detail::GatherMember<T, M>));
+    defstatic(std::string(name + ".scatter"),
+              F_PTR(&detail::ScatterMember<T, M>));
+  }
+
+  /// place the member after the previous ones in snapshot buffers
+  template <typename M>
+  void append_snapshot_slot() {
+    using SlotT = detail::slot_value_t<typename M::type>;
+    auto &curr_class = p_package.p_classes_meta_data.back();
+    const auto offset = (curr_class.snapshot_size + alignof(SlotT) - 1) /
+                        alignof(SlotT) * alignof(SlotT);
+    p_package.p_slot_tables[curr_class.name].push_back(
+        {offset, &detail::ReadSlot<T, M>, &detail::WriteSlot<T, M>});
+    curr_class.snapshot_size = offset + sizeof(SlotT);
+    curr_class.snapshot_offsets = detail::str_append(
+        curr_class.snapshot_offsets,
+        std::string(std::to_string(offset) + "+").c_str());
+  }
+
   Package &p_package;
 };
 
@@ -629,9 +1603,40 @@ CLCXX_API bool clcxx_init(void (*error_handler)(char *),
 CLCXX_API bool remove_package(const char *pack_name);
 CLCXX_API bool register_package(const char *cl_pack,
                                 void (*regfunc)(clcxx::Package &));
+CLCXX_API bool load_package(const char *cl_pack,
+                            void (*regfunc)(clcxx::Package &));
+CLCXX_API size_t package_thunks(const char *cl_pack, void (**thunks)(),
+                                size_t n);
+CLCXX_API bool reserve_objects(const char *cl_pack, const char *class_name,
+                               size_t n);
+/// argument of the dynamic_class thunks of a package
+CLCXX_API const void *class_index_table(const char *cl_pack);
+/// argument of the snapshot and restore thunks of a class
+CLCXX_API const void *class_slot_table(const char *cl_pack,
+                                       const char *class_name);
 CLCXX_API size_t used_bytes_size();
 CLCXX_API size_t max_stack_bytes_size();
 CLCXX_API bool delete_string(char *string);
+/// submit thunk with pointers to its lisp arguments, returns a handle
+CLCXX_API void *async_call(void (*thunk)(), void **args);
+CLCXX_API int async_poll(void *handle);
+CLCXX_API int async_wait(void *handle, int64_t timeout_ms);
+CLCXX_API bool async_cancel(void *handle);
+/// write the converted result to `result`, errors go to the lisp handler
+CLCXX_API bool async_collect(void *handle, void *result);
+CLCXX_API void async_release(void *handle);
+CLCXX_API bool set_async_threads(size_t n_threads);
+/// thunk over n elements of argument columns, results written to output
+CLCXX_API bool parallel_map(void (*thunk)(), void **input_columns,
+                            void *output, size_t n, size_t n_threads);
+/// counters of all threads merged by thunk, returns the number of thunks
+CLCXX_API size_t profile_snapshot(clcxx::ProfileEntry *entries, size_t n);
+CLCXX_API void profile_reset();
+CLCXX_API void trace_start();
+CLCXX_API void trace_stop();
+CLCXX_API void trace_clear();
+/// chrome trace json of the recorded events of all threads
+CLCXX_API bool trace_dump(const char *path);
 }
 
 #define CLCXX_PACKAGE extern "C" CLCXX_ONLY_EXPORTS void
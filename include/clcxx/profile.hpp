@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "clcxx_config.hpp"
+
+namespace clcxx {
+
+/// bucket b counts calls of [2^b, 2^(b+1)) nanoseconds, the last one is open
+constexpr auto PROFILE_BUCKETS = 32;
+
+extern "C" typedef struct {
+  void (*thunk)();
+  const char *name;  // interned, nullptr for thunks outside of packages
+  uint64_t calls;
+  uint64_t errors;
+  uint64_t latency[PROFILE_BUCKETS];
+} ProfileEntry;
+
+/// write up to n entries of the thunks in profile order, returns their count
+CLCXX_API size_t ProfileSnapshot(ProfileEntry *entries, size_t n);
+CLCXX_API void ProfileReset();
+
+namespace detail {
+
+/// counters of one thunk in one thread, only written by that thread
+struct ThunkCounters {
+  std::atomic<uint64_t> calls{0};
+  std::atomic<uint64_t> errors{0};
+  std::atomic<uint64_t> latency[PROFILE_BUCKETS] = {};
+};
+
+/// index of the thunk in the profile tables, called once per thunk
+CLCXX_API size_t profile_slot(void (*thunk)());
+
+/// counters of slot in the calling thread
+CLCXX_API ThunkCounters &thread_counters(size_t slot);
+
+/// name shown for thunk in snapshots
+CLCXX_API void name_thunk(void (*thunk)(), const char *name);
+
+/// interned name of thunk, nullptr for thunks outside of packages
+CLCXX_API const char *thunk_name(void (*thunk)());
+
+inline size_t latency_bucket(uint64_t ns) {
+  size_t bucket = 0;
+  while (ns >>= 1) ++bucket;
+  return bucket < PROFILE_BUCKETS ? bucket : PROFILE_BUCKETS - 1;
+}
+
+inline void bump(std::atomic<uint64_t> &counter) {
+  // single writer, no read-modify-write needed
+  counter.store(counter.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+}
+
+/// counts one call of a thunk from construction to destruction
+class ProfileScope {
+ public:
+  explicit ProfileScope(size_t slot)
+      : p_counters(thread_counters(slot)),
+        p_start(std::chrono::steady_clock::now()) {}
+  ~ProfileScope() {
+    if (!p_done) finish();
+  }
+
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+
+  /// before reporting to lisp, which may not return here
+  void error() {
+    bump(p_counters.errors);
+    finish();
+  }
+
+ private:
+  void finish() {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - p_start)
+                        .count();
+    bump(p_counters.calls);
+    bump(p_counters.latency[latency_bucket(static_cast<uint64_t>(ns))]);
+    p_done = true;
+  }
+
+  ThunkCounters &p_counters;
+  std::chrono::steady_clock::time_point p_start;
+  bool p_done = false;
+};
+
+}  // namespace detail
+}  // namespace clcxx
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "clcxx_config.hpp"
+
+namespace clcxx {
+
+/// events kept per thread, older ones are overwritten
+constexpr size_t TRACE_EVENTS = 1 << 16;
+
+/// record events until TraceStop
+CLCXX_API void TraceStart();
+CLCXX_API void TraceStop();
+/// drop the recorded events of all threads
+CLCXX_API void TraceClear();
+/// write events as chrome trace (perfetto) json, throws on io errors
+CLCXX_API void TraceDump(const std::string &path);
+
+namespace detail {
+
+extern CLCXX_API std::atomic<bool> trace_on;
+
+inline bool tracing() { return trace_on.load(std::memory_order_relaxed); }
+
+/// nanoseconds since the trace epoch
+CLCXX_API uint64_t trace_now();
+
+/// complete event from start_ns until now, thunks are named at dump
+CLCXX_API void trace_span(const char *name, void (*thunk)(),
+                          uint64_t start_ns);
+
+/// point event with a byte count, e.g. an allocation
+CLCXX_API void trace_instant(const char *name, uint64_t bytes);
+
+/// span of its lifetime, recorded when tracing was on at construction
+class TraceScope {
+ public:
+  explicit TraceScope(const char *name, void (*thunk)() = nullptr)
+      : p_name(name), p_thunk(thunk), p_start(tracing() ? trace_now() : 0) {}
+  ~TraceScope() { finish(); }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+  /// before reporting to lisp, which may not return here
+  void finish() {
+    if (p_start == 0) return;
+    trace_span(p_name, p_thunk, p_start);
+    p_start = 0;
+  }
+
+ private:
+  const char *p_name;
+  void (*p_thunk)();
+  uint64_t p_start;
+};
+
+}  // namespace detail
+}  // namespace clcxx
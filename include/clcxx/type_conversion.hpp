@@ -1,10 +1,13 @@
 ﻿#pragma once
 
 #include <complex>
+#include <functional>
 #include <cstdint>
 #include <cstring>
+#include <iterator>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <type_traits>
 
 #include "clcxx_config.hpp"
@@ -21,16 +24,207 @@ namespace clcxx {
 // for nonPOD struct, class, pointer
 // references are converted to pointers
 
-extern "C" typedef union {
-  float Float;
-  double Double;
-  // long double LongDouble;
-} ComplexType;
+// same layout as std::complex<T>,
+// so arrays of complex numbers are shared without conversion
+extern "C" typedef struct {
+  float real;
+  float imag;
+} LispComplexFloat;
+
+extern "C" typedef struct {
+  double real;
+  double imag;
+} LispComplexDouble;
+
+static_assert(sizeof(LispComplexFloat) == sizeof(std::complex<float>) &&
+                  alignof(LispComplexFloat) == alignof(std::complex<float>),
+              "std::complex<float> layout mismatch");
+static_assert(sizeof(LispComplexDouble) == sizeof(std::complex<double>) &&
+                  alignof(LispComplexDouble) == alignof(std::complex<double>),
+              "std::complex<double> layout mismatch");
+
+// contiguous array passed by (pointer, size) without copying
+extern "C" typedef struct {
+  void *data;
+  size_t size;
+} LispSpan;
 
+// string passed by (pointer, length), not NUL terminated and not copied
 extern "C" typedef struct {
-  ComplexType real;
-  ComplexType imag;
-} LispComplex;
+  const char *data;
+  size_t size;
+} LispStringView;
+
+/// Non-owning view over a contiguous array of fundamental, POD or
+/// complex elements
+template <typename T>
+class Span {
+ public:
+  using value_type = T;
+
+  constexpr Span() noexcept : p_data(nullptr), p_size(0) {}
+  constexpr Span(T *data, size_t size) noexcept : p_data(data), p_size(size) {}
+  // std::vector, std::array, C array
+  template <typename C,
+            typename = std::enable_if_t<
+                !std::is_same_v<std::remove_cv_t<C>, Span> &&
+                std::is_convertible_v<decltype(std::data(std::declval<C &>())),
+                                      T *>>>
+  constexpr Span(C &c) noexcept : p_data(std::data(c)), p_size(std::size(c)) {}
+
+  constexpr T *data() const noexcept { return p_data; }
+  constexpr size_t size() const noexcept { return p_size; }
+  constexpr T *begin() const noexcept { return p_data; }
+  constexpr T *end() const noexcept { return p_data + p_size; }
+  constexpr T &operator[](size_t i) const noexcept { return p_data[i]; }
+
+ private:
+  T *p_data;
+  size_t p_size;
+};
+
+/// string result taken from the intern table, lisp borrows it and never
+/// frees it
+class Interned {
+ public:
+  explicit Interned(std::string_view str) : p_str(intern_string(str)) {}
+
+  const char *c_str() const noexcept { return p_str; }
+
+ private:
+  const char *p_str;
+};
+
+/// function returning the interned result of func
+/// e.g. pack.defun("greet", F_PTR(clcxx::interned<&Greet>()))
+template <auto func, typename... Args>
+Interned InternedResult(Args... args) {
+  return Interned(func(std::forward<Args>(args)...));
+}
+
+namespace detail {
+template <auto func, typename R, typename... Args>
+constexpr auto interned_ptr(R (*)(Args...)) {
+  return &InternedResult<func, Args...>;
+}
+}  // namespace detail
+
+template <auto func>
+constexpr auto interned() {
+  return detail::interned_ptr<func>(func);
+}
+
+/// class result moved into caller memory instead of the memory pool
+template <typename T>
+class Placed {
+ public:
+  explicit Placed(T &&value) : p_value(std::move(value)) {}
+
+  T &&release() noexcept { return std::move(p_value); }
+
+ private:
+  T p_value;
+};
+
+/// function constructing the result of func in a pointer passed as the
+/// first argument, e.g. pack.defun("make-a", F_PTR(clcxx::placed<&MakeA>()))
+template <auto func, typename... Args>
+auto PlacedResult(Args... args) {
+  return Placed(func(std::forward<Args>(args)...));
+}
+
+namespace detail {
+template <auto func, typename R, typename... Args>
+constexpr auto placed_ptr(R (*)(Args...)) {
+  return &PlacedResult<func, Args...>;
+}
+}  // namespace detail
+
+template <auto func>
+constexpr auto placed() {
+  return detail::placed_ptr<func>(func);
+}
+
+namespace internal {
+template <typename T>
+struct is_general_class;
+}  // namespace internal
+
+namespace detail {
+/// by-value class parameters are taken as rvalue references by consuming
+template <typename T>
+using consumed_t =
+    std::conditional_t<internal::is_general_class<T>::value, T &&, T>;
+
+template <auto func, typename R, typename... Args>
+R ConsumingCall(consumed_t<Args>... args) {
+  return func(std::forward<consumed_t<Args>>(args)...);
+}
+
+template <auto func, typename R, typename... Args>
+constexpr auto consuming_ptr(R (*)(Args...)) {
+  return &ConsumingCall<func, R, Args...>;
+}
+}  // namespace detail
+
+/// function moving its by-value class arguments out of the lisp handles
+/// instead of copying them, e.g.
+/// pack.defun("sink", F_PTR(clcxx::consuming<&Sink>()))
+template <auto func>
+constexpr auto consuming() {
+  return detail::consuming_ptr<func>(func);
+}
+
+namespace detail {
+/// strings as string views, contiguous containers as spans of their
+/// elements
+template <typename T>
+auto borrow_view(T &ref) {
+  if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+    return std::string_view(ref);
+  } else {
+    using ElementT = std::remove_reference_t<decltype(*std::data(ref))>;
+    return Span<ElementT>(ref);
+  }
+}
+
+template <auto func, typename... Args>
+auto BorrowedResult(Args... args) {
+  static_assert(std::is_lvalue_reference_v<decltype(std::invoke(
+                    func, std::forward<Args>(args)...))>,
+                "borrowed results should be references");
+  return borrow_view(std::invoke(func, std::forward<Args>(args)...));
+}
+
+template <auto func, typename R, typename... Args>
+constexpr auto borrowed_ptr(R (*)(Args...)) {
+  return &BorrowedResult<func, Args...>;
+}
+
+template <auto func, typename R, typename CT, typename... Args>
+constexpr auto borrowed_ptr(R (CT::*)(Args...)) {
+  return &BorrowedResult<func, CT &, Args...>;
+}
+
+template <auto func, typename R, typename CT, typename... Args>
+constexpr auto borrowed_ptr(R (CT::*)(Args...) const) {
+  return &BorrowedResult<func, const CT &, Args...>;
+}
+}  // namespace detail
+
+/// function (or method) returning a reference to a string or contiguous
+/// container as a view of its existing storage. Lisp gets a :string-view
+/// or span that it doesn't own, so no finalizer and no copy, e.g.
+/// .defmethod("matrix-values", F_PTR(clcxx::borrowed<&Matrix::values>()))
+template <auto func>
+constexpr auto borrowed() {
+  return detail::borrowed_ptr<func>(func);
+}
+
+/// specialize to std::true_type to force pointer passing of a POD struct
+template <typename T>
+struct pass_pod_by_pointer
+    : std::bool_constant<(sizeof(T) > CLCXX_POD_BY_VALUE_MAX_SIZE)> {};
 
 template <typename T>
 inline std::string general_class_name();
@@ -57,6 +251,15 @@ struct is_pod_struct {
 template <typename T>
 inline constexpr bool is_pod_struct_v = is_pod_struct<T>::value;
 
+template <typename T, typename Enable = void>
+struct is_large_pod_struct : std::false_type {};
+template <typename T>
+struct is_large_pod_struct<T, typename std::enable_if_t<is_pod_struct_v<T>>>
+    : pass_pod_by_pointer<std::remove_cv_t<T>> {};
+
+template <typename T>
+inline constexpr bool is_large_pod_struct_v = is_large_pod_struct<T>::value;
+
 template <typename T>
 struct is_std_string {
   static constexpr bool value =
@@ -66,10 +269,41 @@ struct is_std_string {
 template <typename T>
 inline constexpr bool is_std_string_v = is_std_string<T>::value;
 
+template <typename T>
+struct is_span : std::false_type {};
+template <typename T>
+struct is_span<Span<T>> : std::true_type {};
+
+template <typename T>
+inline constexpr bool is_span_v = is_span<std::remove_cv_t<T>>::value;
+
+template <typename T>
+inline constexpr bool is_string_view_v =
+    std::is_same_v<std::remove_cv_t<T>, std::string_view>;
+
+template <typename T>
+struct is_placed : std::false_type {};
+template <typename T>
+struct is_placed<Placed<T>> : std::true_type {};
+
+template <typename T>
+inline constexpr bool is_placed_v = is_placed<std::remove_cv_t<T>>::value;
+
+/// large pods and placed results are written to a caller provided pointer
+template <typename T>
+inline constexpr bool is_out_return_v =
+    is_large_pod_struct_v<std::remove_cv_t<T>> || is_placed_v<T>;
+
+template <typename T>
+inline constexpr bool is_interned_v =
+    std::is_same_v<std::remove_cv_t<T>, Interned>;
+
 template <typename T>
 struct is_general_class {
-  static constexpr bool value = !(is_std_string_v<T> || is_complex_v<T> ||
-                                  is_pod_struct_v<T>)&&std::is_class_v<T>;
+  static constexpr bool value =
+      !(is_std_string_v<T> || is_complex_v<T> || is_pod_struct_v<T> ||
+        is_span_v<T> || is_interned_v<T> ||
+        is_string_view_v<T> || is_placed_v<T>)&&std::is_class_v<T>;
 };
 
 template <typename T>
@@ -97,7 +331,10 @@ using define_if_different = typename DefineIfDifferent<T1, T2>::type;
 /// Convenience function to get the lisp data type associated with T
 template <typename T>
 struct static_type_mapping {
-  typedef typename std::conditional_t<is_pod_struct_v<T>, T, void *> type;
+  typedef typename std::conditional_t<
+      is_pod_struct_v<T>,
+      std::conditional_t<is_large_pod_struct_v<T>, const void *, T>, void *>
+      type;
   static std::string lisp_type() {
     static_assert(std::is_class_v<T>, "Unkown type");
     using ClassT = std::remove_cv_t<T>;
@@ -239,6 +476,17 @@ struct static_type_mapping<const T &> {
   }
 };
 
+// rvalue references are passed as pointers too, the object behind the
+// handle is moved from and stays in a valid but unspecified state
+template <typename T>
+struct static_type_mapping<T &&> {
+  typedef void *type;
+  static std::string lisp_type() {
+    return std::string("(:rvalue-reference " +
+                       static_type_mapping<T>::lisp_type() + ")");
+  }
+};
+
 // resolve const types
 template <typename T>
 struct static_type_mapping<const T> {
@@ -295,6 +543,23 @@ struct static_type_mapping<std::string> {
   static std::string lisp_type() { return ":string+ptr"; }
 };
 template <>
+struct static_type_mapping<std::string_view> {
+  typedef LispStringView type;
+  static std::string lisp_type() { return ":string-view"; }
+};
+// written to the out pointer
+template <typename T>
+struct static_type_mapping<Placed<T>> {
+  typedef void *type;
+  static std::string lisp_type() { return static_type_mapping<T>::lisp_type(); }
+};
+// borrowed, lisp doesn't free it
+template <>
+struct static_type_mapping<Interned> {
+  typedef const char *type;
+  static std::string lisp_type() { return ":string"; }
+};
+template <>
 struct static_type_mapping<void> {
   typedef void type;
   static std::string lisp_type() { return ":void"; }
@@ -302,7 +567,7 @@ struct static_type_mapping<void> {
 
 template <>
 struct static_type_mapping<std::complex<float>> {
-  typedef LispComplex type;
+  typedef LispComplexFloat type;
   static std::string lisp_type() {
     return std::string(std::string("(:complex ") +
                        static_type_mapping<float>::lisp_type() + ")");
@@ -311,13 +576,25 @@ struct static_type_mapping<std::complex<float>> {
 
 template <>
 struct static_type_mapping<std::complex<double>> {
-  typedef LispComplex type;
+  typedef LispComplexDouble type;
   static std::string lisp_type() {
     return std::string(std::string("(:complex ") +
                        static_type_mapping<double>::lisp_type() + ")");
   }
 };
 
+template <typename T>
+struct static_type_mapping<Span<T>> {
+  static_assert(std::is_fundamental_v<std::remove_cv_t<T>> ||
+                    is_pod_struct_v<std::remove_cv_t<T>> ||
+                    is_complex_v<std::remove_cv_t<T>>,
+                "Span elements should have a lisp compatible layout");
+  typedef LispSpan type;
+  static std::string lisp_type() {
+    return std::string("(:span " + static_type_mapping<T>::lisp_type() + ")");
+  }
+};
+
 // ------------------------------------------------------------------//
 // Box an automatically converted value
 
@@ -355,18 +632,30 @@ struct Box<const char *, const char *> {
   }
 };
 
+template <>
+struct Box<std::complex<float>, LispComplexFloat> {
+  inline LispComplexFloat operator()(std::complex<float> x) {
+    return LispComplexFloat{std::real(x), std::imag(x)};
+  }
+};
+
+template <>
+struct Box<std::complex<double>, LispComplexDouble> {
+  inline LispComplexDouble operator()(std::complex<double> x) {
+    return LispComplexDouble{std::real(x), std::imag(x)};
+  }
+};
+
 template <typename T>
-struct Box<std::complex<T>, LispComplex> {
-  inline LispComplex operator()(std::complex<T> x) {
-    LispComplex c;
-    if constexpr (std::is_same_v<float, std::remove_cv_t<T>>) {
-      c.real.Float = std::real(x);
-      c.imag.Float = std::imag(x);
-    } else {
-      c.real.Double = std::real(x);
-      c.imag.Double = std::imag(x);
-    }
-    return c;
+struct Box<Span<T>, LispSpan> {
+  inline LispSpan operator()(Span<T> x) {
+    return LispSpan{const_cast<std::remove_cv_t<T> *>(x.data()), x.size()};
+  }
+};
+template <>
+struct Box<std::string_view, LispStringView> {
+  inline LispStringView operator()(std::string_view x) {
+    return LispStringView{x.data(), x.size()};
   }
 };
 // unbox -----------------------------------------------------------------//
@@ -382,7 +671,11 @@ struct UnBox {
 template <typename CppT, typename LispT>
 struct UnBox<CppT *, LispT> {
   inline CppT *operator()(LispT lisp_val) {
-    return static_cast<CppT *>(lisp_val);
+    if constexpr (is_general_class_v<std::remove_cv_t<CppT>>) {
+      return checked_handle<CppT>(lisp_val);
+    } else {
+      return static_cast<CppT *>(lisp_val);
+    }
   }
 };
 
@@ -401,16 +694,30 @@ struct UnBox<const char *, const char *> {
 };
 
 template <>
-struct UnBox<std::complex<float>, LispComplex> {
-  inline std::complex<float> operator()(LispComplex v) {
-    return std::complex<float>(v.real.Float, v.imag.Float);
+struct UnBox<std::complex<float>, LispComplexFloat> {
+  inline std::complex<float> operator()(LispComplexFloat v) {
+    return std::complex<float>(v.real, v.imag);
+  }
+};
+
+template <>
+struct UnBox<std::complex<double>, LispComplexDouble> {
+  inline std::complex<double> operator()(LispComplexDouble v) {
+    return std::complex<double>(v.real, v.imag);
+  }
+};
+
+template <typename T>
+struct UnBox<Span<T>, LispSpan> {
+  inline Span<T> operator()(LispSpan v) {
+    return Span<T>(static_cast<T *>(v.data), v.size);
   }
 };
 
 template <>
-struct UnBox<std::complex<double>, LispComplex> {
-  inline std::complex<double> operator()(LispComplex v) {
-    return std::complex<double>(v.real.Double, v.imag.Double);
+struct UnBox<std::string_view, LispStringView> {
+  inline std::string_view operator()(LispStringView v) {
+    return v.size == 0 ? std::string_view() : std::string_view(v.data, v.size);
   }
 };
 
@@ -430,9 +737,10 @@ struct ConvertToCpp {
 
 // Fundamental/array/pod types conversion
 template <typename CppT>
-struct ConvertToCpp<CppT, typename std::enable_if_t<
-                              std::is_fundamental_v<CppT> ||
-                              std::is_array_v<CppT> || is_pod_struct_v<CppT>>> {
+struct ConvertToCpp<
+    CppT, typename std::enable_if_t<
+              std::is_fundamental_v<CppT> || std::is_array_v<CppT> ||
+              (is_pod_struct_v<CppT> && !is_large_pod_struct_v<CppT>)>> {
   using LispT = typename static_type_mapping<CppT>::type;
   inline CppT operator()(LispT lisp_val) const {
     static_assert(std::is_same_v<LispT, CppT>, "Fundamental type mismatch");
@@ -440,14 +748,29 @@ struct ConvertToCpp<CppT, typename std::enable_if_t<
   }
 };
 
+// large pod types are passed by const pointer
+template <typename CppT>
+struct ConvertToCpp<CppT,
+                    typename std::enable_if_t<is_large_pod_struct_v<CppT>>> {
+  using LispT = typename static_type_mapping<CppT>::type;
+  inline const CppT &operator()(LispT lisp_val) const {
+    static_assert(std::is_same_v<LispT, const void *>, "type mismatch");
+    return *static_cast<const CppT *>(lisp_val);
+  }
+};
+
 namespace detail {
 template <typename CppT, typename LispT>
 struct RefToCpp {
   // reference to pointer
   CppT operator()(LispT lisp_val) const {
-    auto obj_ptr =
-        static_cast<typename std::remove_reference_t<CppT> *>(lisp_val);
-    return *obj_ptr;
+    using ObjT = std::remove_reference_t<CppT>;
+    // static_cast moves for rvalue references
+    if constexpr (is_general_class_v<std::remove_cv_t<ObjT>>) {
+      return static_cast<CppT>(*checked_handle<ObjT>(lisp_val));
+    } else {
+      return static_cast<CppT>(*static_cast<ObjT *>(lisp_val));
+    }
   }
 };
 }  // namespace detail
@@ -483,6 +806,15 @@ struct ConvertToCpp<CppT, typename std::enable_if_t<is_complex_v<CppT>>> {
   }
 };
 
+// spans
+template <typename CppT>
+struct ConvertToCpp<CppT, typename std::enable_if_t<is_span_v<CppT>>> {
+  using LispT = typename static_type_mapping<CppT>::type;
+  CppT operator()(LispT lisp_val) const {
+    return UnBox<CppT, LispT>()(lisp_val);
+  }
+};
+
 // strings
 template <typename CppT>
 struct ConvertToCpp<CppT, typename std::enable_if_t<is_std_string_v<CppT>>> {
@@ -493,6 +825,15 @@ struct ConvertToCpp<CppT, typename std::enable_if_t<is_std_string_v<CppT>>> {
   }
 };
 
+// string views share the lisp buffer
+template <typename CppT>
+struct ConvertToCpp<CppT, typename std::enable_if_t<is_string_view_v<CppT>>> {
+  using LispT = typename static_type_mapping<CppT>::type;
+  std::string_view operator()(LispStringView lisp_val) const {
+    return UnBox<std::string_view, LispStringView>()(lisp_val);
+  }
+};
+
 // class
 template <typename CppT>
 struct ConvertToCpp<CppT, typename std::enable_if_t<is_general_class_v<CppT>>> {
@@ -501,8 +842,7 @@ struct ConvertToCpp<CppT, typename std::enable_if_t<is_general_class_v<CppT>>> {
   CppT &operator()(LispT class_ptr) const {
     static_assert(std::is_same_v<std::remove_const_t<LispT>, void *>,
                   "type mismatch");
-    auto cpp_class_ptr = static_cast<CppT *>(class_ptr);
-    return *cpp_class_ptr;
+    return *checked_handle<CppT>(class_ptr);
   }
 };
 
@@ -530,11 +870,11 @@ struct ConvertToLisp<CppT, typename std::enable_if_t<std::is_void_v<CppT>>> {
 
 // Fundamental type conversion
 template <typename CppT>
-struct ConvertToLisp<CppT,
-                     typename std::enable_if_t<!std::is_void_v<CppT> &&
-                                               (std::is_fundamental_v<CppT> ||
-                                                std::is_array_v<CppT> ||
-                                                is_pod_struct_v<CppT>)>> {
+struct ConvertToLisp<
+    CppT, typename std::enable_if_t<
+              !std::is_void_v<CppT> &&
+              (std::is_fundamental_v<CppT> || std::is_array_v<CppT> ||
+               (is_pod_struct_v<CppT> && !is_large_pod_struct_v<CppT>))>> {
   using type = typename static_type_mapping<CppT>::type;
   CppT operator()(CppT cpp_val) const {
     static_assert(std::is_same_v<type, CppT>, "type mismatch");
@@ -542,6 +882,25 @@ struct ConvertToLisp<CppT,
   }
 };
 
+// large pod types are returned through a caller provided pointer
+template <typename CppT>
+struct ConvertToLisp<CppT,
+                     typename std::enable_if_t<is_large_pod_struct_v<CppT>>> {
+  using type = typename static_type_mapping<CppT>::type;
+  void operator()(void *out, const CppT &cpp_val) const {
+    std::memcpy(out, std::addressof(cpp_val), sizeof(CppT));
+  }
+};
+
+template <typename CppT>
+struct ConvertToLisp<CppT, typename std::enable_if_t<is_placed_v<CppT>>> {
+  using type = typename static_type_mapping<CppT>::type;
+  template <typename T>
+  void operator()(void *out, Placed<T> &&placed) const {
+    ::new (out) T(placed.release());
+  }
+};
+
 namespace detail {
 template <typename CppT, typename LispT>
 struct RefToLisp {
@@ -583,7 +942,19 @@ struct ConvertToLisp<CppT, typename std::enable_if_t<is_complex_v<CppT>>> {
   using type = typename static_type_mapping<CppT>::type;
   using LispT = typename static_type_mapping<CppT>::type;
   LispT operator()(CppT cpp_val) const {
-    static_assert(std::is_same_v<LispT, LispComplex>, "type mismatch");
+    static_assert(std::is_same_v<LispT, LispComplexFloat> ||
+                      std::is_same_v<LispT, LispComplexDouble>,
+                  "type mismatch");
+    return Box<CppT, LispT>()(cpp_val);
+  }
+};
+
+// spans
+template <typename CppT>
+struct ConvertToLisp<CppT, typename std::enable_if_t<is_span_v<CppT>>> {
+  using type = typename static_type_mapping<CppT>::type;
+  using LispT = typename static_type_mapping<CppT>::type;
+  LispT operator()(CppT cpp_val) const {
     return Box<CppT, LispT>()(cpp_val);
   }
 };
@@ -598,6 +969,21 @@ struct ConvertToLisp<CppT, typename std::enable_if_t<is_std_string_v<CppT>>> {
   }
 };
 
+// views of C++ strings, lisp doesn't own them
+template <typename CppT>
+struct ConvertToLisp<CppT, typename std::enable_if_t<is_string_view_v<CppT>>> {
+  using type = typename static_type_mapping<CppT>::type;
+  LispStringView operator()(std::string_view str) const {
+    return Box<std::string_view, LispStringView>()(str);
+  }
+};
+
+template <typename CppT>
+struct ConvertToLisp<CppT, typename std::enable_if_t<is_interned_v<CppT>>> {
+  using type = typename static_type_mapping<CppT>::type;
+  const char *operator()(const Interned &str) const { return str.c_str(); }
+};
+
 // class exclude std::string
 template <typename CppT>
 struct ConvertToLisp<CppT,
@@ -608,8 +994,7 @@ struct ConvertToLisp<CppT,
     static_assert(std::is_same_v<std::remove_const_t<LispT>, void *>,
                   "type mismatch");
 
-    auto obj_ptr = static_cast<CppT *>(
-        MemPool().allocate(sizeof(CppT), std::alignment_of_v<CppT>));
+    auto obj_ptr = allocate_object<CppT>();
     ::new (obj_ptr) CppT(std::move(cpp_class));
     return static_cast<LispT>(obj_ptr);
   }
@@ -624,6 +1009,11 @@ struct CppTypeAdapter<
     T, typename std::enable_if_t<internal::is_general_class_v<T>>> {
   using type = T &;
 };
+template <typename T>
+struct CppTypeAdapter<
+    T, typename std::enable_if_t<internal::is_large_pod_struct_v<T>>> {
+  using type = const T &;
+};
 
 }  // namespace internal
 
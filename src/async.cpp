@@ -0,0 +1,291 @@
+
+#include "clcxx/async.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+#include "clcxx/clcxx_config.hpp"
+
+namespace clcxx {
+
+namespace detail {
+
+void note_signature(FuncPtr thunk, SignatureGetter signature) {
+  if (registry().has_current_package()) {
+    registry().current_package().add_packed_signature(thunk, signature);
+  }
+}
+
+const PackedSignature *find_signature(FuncPtr thunk) {
+  return registry().find_signature(thunk);
+}
+
+}  // namespace detail
+
+ThreadPool::ThreadPool(size_t n_threads) : p_stop(false) {
+  n_threads = std::max<size_t>(n_threads, 1);
+  p_workers.reserve(n_threads);
+  for (size_t i = 0; i < n_threads; ++i) {
+    p_workers.emplace_back([this] { work(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(p_mutex);
+    p_stop = true;
+  }
+  p_cv.notify_all();
+  for (auto &worker : p_workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(p_mutex);
+    p_tasks.push_back(std::move(task));
+  }
+  p_cv.notify_one();
+}
+
+void ThreadPool::work() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(p_mutex);
+      p_cv.wait(lock, [this] { return p_stop || !p_tasks.empty(); });
+      if (p_tasks.empty()) return;
+      task = std::move(p_tasks.front());
+      p_tasks.pop_front();
+    }
+    task();
+  }
+}
+
+namespace {
+std::shared_ptr<ThreadPool> &async_pool_ptr() {
+  static std::shared_ptr<ThreadPool> pool;
+  return pool;
+}
+
+std::mutex &async_pool_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+}  // namespace
+
+std::shared_ptr<ThreadPool> AsyncPool() {
+  std::lock_guard<std::mutex> lock(async_pool_mutex());
+  auto &pool = async_pool_ptr();
+  if (!pool) {
+    pool = std::make_shared<ThreadPool>(std::thread::hardware_concurrency());
+  }
+  return pool;
+}
+
+void set_async_pool_size(size_t n_threads) {
+  auto new_pool = std::make_shared<ThreadPool>(n_threads);
+  std::shared_ptr<ThreadPool> old_pool;
+  {
+    std::lock_guard<std::mutex> lock(async_pool_mutex());
+    old_pool = std::exchange(async_pool_ptr(), std::move(new_pool));
+  }
+  // joined outside of the lock by its last user
+  old_pool.reset();
+}
+
+AsyncCall::AsyncCall(const detail::PackedSignature &signature, void **args)
+    : p_signature(signature), p_result(nullptr), p_state(AsyncState::queued) {
+  // arguments then result, each aligned in one block
+  std::vector<size_t> offsets;
+  size_t size = 0;
+  const auto place = [&size](size_t bytes, size_t alignment) {
+    size = (size + alignment - 1) / alignment * alignment;
+    const auto offset = size;
+    size += bytes;
+    return offset;
+  };
+  for (size_t i = 0; i < signature.arg_sizes.size(); ++i) {
+    offsets.push_back(
+        place(signature.arg_sizes[i], signature.arg_alignments[i]));
+  }
+  const auto result_offset =
+      place(signature.result_size, signature.result_alignment);
+  p_storage.resize((size + sizeof(std::max_align_t) - 1) /
+                   sizeof(std::max_align_t));
+  auto base = reinterpret_cast<char *>(p_storage.data());
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    std::memcpy(base + offsets[i], args[i], signature.arg_sizes[i]);
+    p_args.push_back(base + offsets[i]);
+  }
+  if (signature.result_size != 0) {
+    p_result = base + result_offset;
+  }
+}
+
+void AsyncCall::run() {
+  {
+    std::lock_guard<std::mutex> lock(p_mutex);
+    if (p_state == AsyncState::cancelled) return;
+    p_state = AsyncState::running;
+  }
+  auto state = AsyncState::done;
+  std::string error;
+  try {
+    p_signature.call(p_args.data(), p_result);
+  } catch (const std::exception &err) {
+    state = AsyncState::failed;
+    error = err.what();
+  } catch (...) {
+    state = AsyncState::failed;
+    error = "Unknown C++ exception in async call";
+  }
+  {
+    std::lock_guard<std::mutex> lock(p_mutex);
+    p_state = state;
+    p_error = std::move(error);
+  }
+  p_cv.notify_all();
+}
+
+AsyncState AsyncCall::state() {
+  std::lock_guard<std::mutex> lock(p_mutex);
+  return p_state;
+}
+
+AsyncState AsyncCall::wait(int64_t timeout_ms) {
+  std::unique_lock<std::mutex> lock(p_mutex);
+  const auto finished = [this] {
+    return p_state != AsyncState::queued && p_state != AsyncState::running;
+  };
+  if (timeout_ms < 0) {
+    p_cv.wait(lock, finished);
+  } else {
+    p_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), finished);
+  }
+  return p_state;
+}
+
+bool AsyncCall::cancel() {
+  {
+    std::lock_guard<std::mutex> lock(p_mutex);
+    if (p_state != AsyncState::queued) return false;
+    p_state = AsyncState::cancelled;
+  }
+  p_cv.notify_all();
+  return true;
+}
+
+void AsyncCall::collect(void *result) {
+  std::lock_guard<std::mutex> lock(p_mutex);
+  switch (p_state) {
+    case AsyncState::done:
+      if (p_result != nullptr) {
+        std::memcpy(result, p_result, p_signature.result_size);
+      }
+      return;
+    case AsyncState::failed:
+      throw std::runtime_error(p_error);
+    case AsyncState::cancelled:
+      throw std::runtime_error("Async call was cancelled");
+    default:
+      throw std::runtime_error("Async call is not finished");
+  }
+}
+
+namespace {
+/// shared with helper tasks which may start after the batch is finished
+struct MapBatch {
+  const detail::PackedSignature *signature;
+  std::vector<char *> columns;
+  char *output;
+  size_t n;
+  size_t chunk_size;
+  size_t n_chunks;
+  std::atomic<size_t> next_chunk{0};
+  size_t done_chunks = 0;
+  std::string error;
+  std::mutex mutex;
+  std::condition_variable cv;
+
+  /// take chunks until none is left
+  void work() {
+    const auto &sig = *signature;
+    std::vector<void *> args(columns.size());
+    for (;;) {
+      const auto chunk = next_chunk.fetch_add(1);
+      if (chunk >= n_chunks) return;
+      const auto end = std::min(n, (chunk + 1) * chunk_size);
+      try {
+        for (auto i = chunk * chunk_size; i < end; ++i) {
+          for (size_t k = 0; k < columns.size(); ++k) {
+            args[k] = columns[k] + i * sig.arg_sizes[k];
+          }
+          sig.call(args.data(), output == nullptr
+                                    ? nullptr
+                                    : output + i * sig.result_size);
+        }
+      } catch (const std::exception &err) {
+        fail(err.what());
+      } catch (...) {
+        fail("Unknown C++ exception in parallel map");
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++done_chunks;
+      }
+      cv.notify_all();
+    }
+  }
+
+  void fail(const char *what) {
+    // skip the remaining chunks, they count as done
+    const auto skipped = n_chunks - std::min(n_chunks, next_chunk.exchange(
+                                                           n_chunks));
+    std::lock_guard<std::mutex> lock(mutex);
+    if (error.empty()) error = what;
+    done_chunks += skipped;
+  }
+};
+}  // namespace
+
+void ParallelMap(const detail::PackedSignature &signature,
+                 void **input_columns, void *output, size_t n,
+                 size_t n_threads) {
+  if (n == 0) return;
+  if (signature.result_size != 0 && output == nullptr) {
+    throw std::runtime_error("Parallel map needs an output column");
+  }
+  // held until the batch is done, the pool may be replaced meanwhile
+  const auto pool = AsyncPool();
+  if (n_threads == 0) n_threads = pool->size();
+  auto batch = std::make_shared<MapBatch>();
+  batch->signature = &signature;
+  for (size_t k = 0; k < signature.arg_sizes.size(); ++k) {
+    batch->columns.push_back(static_cast<char *>(input_columns[k]));
+  }
+  batch->output = signature.result_size == 0 ? nullptr
+                                             : static_cast<char *>(output);
+  batch->n = n;
+  // several chunks per thread so that faster threads take more of them
+  batch->chunk_size = std::max<size_t>(1, n / (n_threads * 8));
+  batch->n_chunks = (n + batch->chunk_size - 1) / batch->chunk_size;
+  const auto helpers = std::min(n_threads, batch->n_chunks) - 1;
+  for (size_t i = 0; i < helpers; ++i) {
+    pool->submit([batch] { batch->work(); });
+  }
+  batch->work();
+  std::unique_lock<std::mutex> lock(batch->mutex);
+  batch->cv.wait(lock,
+                 [&batch] { return batch->done_chunks == batch->n_chunks; });
+  if (!batch->error.empty()) {
+    throw std::runtime_error(batch->error);
+  }
+}
+
+}  // namespace clcxx
@@ -1,8 +1,10 @@
 ﻿
 #include <cstdint>
 #include <cstring>
+#include <memory>
 #include <string>
 
+#include "clcxx/async.hpp"
 #include "clcxx/clcxx.hpp"
 #include "clcxx/clcxx_config.hpp"
 #include "clcxx/type_conversion.hpp"
@@ -34,9 +36,15 @@ CLCXX_API bool remove_package(const char *pack_name) {
 
 CLCXX_API bool register_package(const char *cl_pack,
                                 void (*regfunc)(clcxx::Package &)) {
+  clcxx::detail::TraceScope trace("register_package");
   try {
     clcxx::Package &pack = clcxx::registry().create_package(cl_pack);
-    regfunc(pack);
+    {
+      clcxx::detail::TraceScope trace_regfunc("package function");
+      regfunc(pack);
+    }
+    pack.collect_thunks();
+    clcxx::detail::TraceScope trace_send("send meta data");
     for (auto Class : pack.classes_meta_data()) {
       clcxx::MetaData m;
       m.Class = Class;
@@ -66,6 +74,102 @@ CLCXX_API bool register_package(const char *cl_pack,
   return false;
 }
 
+CLCXX_API bool load_package(const char *cl_pack,
+                            void (*regfunc)(clcxx::Package &)) {
+  // same as register_package without sending meta data,
+  // used with lisp bindings generated at build time
+  clcxx::detail::TraceScope trace("load_package");
+  try {
+    clcxx::Package &pack = clcxx::registry().create_package(cl_pack);
+    {
+      clcxx::detail::TraceScope trace_regfunc("package function");
+      regfunc(pack);
+    }
+    pack.collect_thunks();
+    for (auto Class : pack.classes_meta_data()) {
+      clcxx::detail::remove_c_strings(Class);
+    }
+    pack.classes_meta_data().clear();
+    for (auto Constant : pack.constants_meta_data()) {
+      clcxx::detail::remove_c_strings(Constant);
+    }
+    pack.constants_meta_data().clear();
+    for (auto Func : pack.functions_meta_data()) {
+      clcxx::detail::remove_c_strings(Func);
+    }
+    pack.functions_meta_data().clear();
+    clcxx::registry().reset_current_package();
+    return true;
+  } catch (const std::runtime_error &err) {
+    clcxx::LispError(const_cast<char *>(err.what()));
+  }
+  return false;
+}
+
+CLCXX_API size_t package_thunks(const char *cl_pack, void (**thunks)(),
+                                size_t n) {
+  try {
+    const auto &table =
+        clcxx::registry().get_package_iter(cl_pack)->second->thunks();
+    for (size_t i = 0; i < n && i < table.size(); ++i) {
+      thunks[i] = table[i];
+    }
+    return table.size();
+  } catch (const std::runtime_error &err) {
+    clcxx::LispError(const_cast<char *>(err.what()));
+  }
+  return 0;
+}
+
+CLCXX_API bool reserve_objects(const char *cl_pack, const char *class_name,
+                               size_t n) {
+  try {
+    // the meta data is released once registered, classes are looked up
+    // in the tables the package keeps
+    const auto &pack = *clcxx::registry().get_package_iter(cl_pack)->second;
+    if (pack.slot_table(class_name) == nullptr) {
+      throw std::runtime_error("Class " + std::string(class_name) +
+                               " was not found in package " + cl_pack);
+    }
+    const auto reserve = pack.reserve_function(class_name);
+    if (reserve == nullptr) {
+      throw std::runtime_error("Class " + std::string(class_name) +
+                               " has no slab");
+    }
+    reserve(n);
+    return true;
+  } catch (const std::runtime_error &err) {
+    clcxx::LispError(const_cast<char *>(err.what()));
+  }
+  return false;
+}
+
+CLCXX_API const void *class_index_table(const char *cl_pack) {
+  try {
+    const auto &pack = *clcxx::registry().get_package_iter(cl_pack)->second;
+    return &pack.class_indexes();
+  } catch (const std::runtime_error &err) {
+    clcxx::LispError(const_cast<char *>(err.what()));
+  }
+  return nullptr;
+}
+
+CLCXX_API const void *class_slot_table(const char *cl_pack,
+                                       const char *class_name) {
+  try {
+    const auto &pack = *clcxx::registry().get_package_iter(cl_pack)->second;
+    const auto *table = pack.slot_table(class_name);
+    if (table == nullptr) {
+      throw std::runtime_error("Class " + std::string(class_name) +
+                               " was not found in package " + cl_pack);
+    }
+    return table;
+  } catch (const std::runtime_error &err) {
+    clcxx::LispError(const_cast<char *>(err.what()));
+  }
+  return nullptr;
+}
+
 CLCXX_API size_t used_bytes_size() {
   return clcxx::MemPool().get_num_of_bytes_allocated();
 }
@@ -84,4 +188,117 @@ CLCXX_API bool delete_string(char *str) {
   }
   return false;
 }
+
+// async handles share the call with the queued task
+using AsyncHandle = std::shared_ptr<clcxx::AsyncCall>;
+
+static clcxx::AsyncCall &async_handle_call(void *handle) {
+  if (handle == nullptr) {
+    throw std::runtime_error("Null async handle");
+  }
+  return **static_cast<AsyncHandle *>(handle);
+}
+
+CLCXX_API void *async_call(void (*thunk)(), void **args) {
+  try {
+    const auto *signature = clcxx::detail::find_signature(thunk);
+    if (signature == nullptr) {
+      throw std::runtime_error("Thunk could not be called asynchronously");
+    }
+    auto call = std::make_shared<clcxx::AsyncCall>(*signature, args);
+    clcxx::AsyncPool()->submit([call] { call->run(); });
+    return new AsyncHandle(std::move(call));
+  } catch (const std::runtime_error &err) {
+    clcxx::LispError(const_cast<char *>(err.what()));
+  }
+  return nullptr;
+}
+
+CLCXX_API int async_poll(void *handle) {
+  try {
+    return static_cast<int>(async_handle_call(handle).state());
+  } catch (const std::runtime_error &err) {
+    clcxx::LispError(const_cast<char *>(err.what()));
+  }
+  return -1;
+}
+
+CLCXX_API int async_wait(void *handle, int64_t timeout_ms) {
+  try {
+    return static_cast<int>(async_handle_call(handle).wait(timeout_ms));
+  } catch (const std::runtime_error &err) {
+    clcxx::LispError(const_cast<char *>(err.what()));
+  }
+  return -1;
+}
+
+CLCXX_API bool async_cancel(void *handle) {
+  try {
+    return async_handle_call(handle).cancel();
+  } catch (const std::runtime_error &err) {
+    clcxx::LispError(const_cast<char *>(err.what()));
+  }
+  return false;
+}
+
+CLCXX_API bool async_collect(void *handle, void *result) {
+  try {
+    async_handle_call(handle).collect(result);
+    return true;
+  } catch (const std::runtime_error &err) {
+    clcxx::LispError(const_cast<char *>(err.what()));
+  }
+  return false;
+}
+
+CLCXX_API void async_release(void *handle) {
+  delete static_cast<AsyncHandle *>(handle);
+}
+
+CLCXX_API bool parallel_map(void (*thunk)(), void **input_columns,
+                            void *output, size_t n, size_t n_threads) {
+  try {
+    const auto *signature = clcxx::detail::find_signature(thunk);
+    if (signature == nullptr) {
+      throw std::runtime_error("Thunk could not be called in parallel");
+    }
+    clcxx::ParallelMap(*signature, input_columns, output, n, n_threads);
+    return true;
+  } catch (const std::runtime_error &err) {
+    clcxx::LispError(const_cast<char *>(err.what()));
+  }
+  return false;
+}
+
+CLCXX_API size_t profile_snapshot(clcxx::ProfileEntry *entries, size_t n) {
+  return clcxx::ProfileSnapshot(entries, n);
+}
+
+CLCXX_API void profile_reset() { clcxx::ProfileReset(); }
+
+CLCXX_API void trace_start() { clcxx::TraceStart(); }
+
+CLCXX_API void trace_stop() { clcxx::TraceStop(); }
+
+CLCXX_API void trace_clear() { clcxx::TraceClear(); }
+
+CLCXX_API bool trace_dump(const char *path) {
+  try {
+    clcxx::TraceDump(path);
+    return true;
+  } catch (const std::runtime_error &err) {
+    clcxx::LispError(const_cast<char *>(err.what()));
+  }
+  return false;
+}
+
+CLCXX_API bool set_async_threads(size_t n_threads) {
+  try {
+    clcxx::set_async_pool_size(n_threads);
+    return true;
+  } catch (const std::exception &err) {
+    clcxx::LispError(const_cast<char *>(err.what()));
+  }
+  return false;
+}
 }
@@ -1,9 +1,19 @@
 ﻿
 #include "clcxx/clcxx.hpp"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <cstring>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "clcxx/clcxx_config.hpp"
 
@@ -21,8 +31,228 @@ VerboseResource &MemPool() {
   return verbose_arena;
 }
 
+SlabResource::SlabResource(size_t object_size, size_t object_alignment,
+                           std::pmr::memory_resource *upstream_resource)
+    : upstream_resource_(upstream_resource),
+      alignment_(std::max(object_alignment, alignof(FreeBlock))),
+      next_chunk_blocks_(16),
+      num_of_free_blocks_(0),
+      free_list_(nullptr) {
+  const auto size = std::max(object_size, sizeof(FreeBlock));
+  block_size_ = (size + alignment_ - 1) / alignment_ * alignment_;
+}
+
+SlabResource::~SlabResource() {
+  for (auto [chunk, bytes] : chunks_) {
+    upstream_resource_->deallocate(chunk, bytes, alignment_);
+  }
+}
+
+void SlabResource::reserve(size_t n) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (num_of_free_blocks_ < n) grow(n - num_of_free_blocks_);
+}
+
+size_t SlabResource::free_blocks() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_of_free_blocks_;
+}
+
+void SlabResource::grow(size_t n) {
+  const auto bytes = n * block_size_;
+  auto chunk =
+      static_cast<char *>(upstream_resource_->allocate(bytes, alignment_));
+  chunks_.emplace_back(chunk, bytes);
+  // keep address order so consecutive allocations are adjacent
+  for (size_t i = n; i-- > 0;) {
+    auto block = reinterpret_cast<FreeBlock *>(chunk + i * block_size_);
+    block->next = free_list_;
+    free_list_ = block;
+  }
+  num_of_free_blocks_ += n;
+}
+
+void *SlabResource::do_allocate(size_t bytes, size_t alignment) {
+#if CLCXX_TRACE
+  if (detail::tracing()) detail::trace_instant("slab-allocate", bytes);
+#endif
+  if (!fits(bytes, alignment)) {
+    return upstream_resource_->allocate(bytes, alignment);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (free_list_ == nullptr) {
+    grow(next_chunk_blocks_);
+    next_chunk_blocks_ = std::min<size_t>(next_chunk_blocks_ * 2, 4096);
+  }
+  auto block = free_list_;
+  free_list_ = block->next;
+  --num_of_free_blocks_;
+  return block;
+}
+
+void SlabResource::do_deallocate(void *p, size_t bytes, size_t alignment) {
+#if CLCXX_TRACE
+  if (detail::tracing()) detail::trace_instant("slab-deallocate", bytes);
+#endif
+  if (!fits(bytes, alignment)) {
+    upstream_resource_->deallocate(p, bytes, alignment);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto block = static_cast<FreeBlock *>(p);
+  block->next = free_list_;
+  free_list_ = block;
+  ++num_of_free_blocks_;
+}
+
+const char *intern_string(std::string_view str) {
+  // never destroyed, pointers stay valid during static destruction too
+  static auto &strings = *new std::deque<std::string>();
+  static auto &table = *new std::unordered_set<std::string_view>();
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto iter = table.find(str);
+  if (iter != table.end()) return iter->data();
+  const auto &stored = strings.emplace_back(str);
+  table.insert(stored);
+  return stored.c_str();
+}
+
 namespace detail {
 
+namespace {
+/// ancestors of each class tag, transitively closed and sorted
+using HandleAncestors = std::unordered_map<uint32_t, std::vector<uint32_t>>;
+
+/// registration copies the table and publishes the copy, checks read the
+/// published one without a lock. Replaced tables are kept alive since a
+/// check may still read them, there is one per registered base class.
+struct HandleBases {
+  std::mutex mutex;  // serializes registrations
+  std::deque<HandleAncestors> versions;
+  std::atomic<const HandleAncestors *> current{nullptr};
+};
+
+HandleBases &handle_bases() {
+  static auto &bases = *new HandleBases();
+  return bases;
+}
+
+constexpr size_t HANDLE_SHARDS = 64;
+/// freed handles remembered by each shard, see CLCXX_FREED_HANDLES
+constexpr size_t FREED_HANDLES_PER_SHARD =
+    std::max<size_t>(CLCXX_FREED_HANDLES / HANDLE_SHARDS, 1);
+
+/// handles of objects allocated for lisp by allocate_object, split in
+/// shards by address so that threads rarely share a lock
+struct HandleShard {
+  std::shared_mutex mutex;
+  std::unordered_map<const void *, uint32_t> live;
+  // freed handle -> generation, the queue holds them oldest first
+  std::unordered_map<const void *, uint64_t> freed;
+  std::deque<std::pair<const void *, uint64_t>> freed_order;
+  uint64_t generation = 0;
+};
+
+HandleShard &handle_shard(const void *ptr) {
+  static auto &shards = *new std::array<HandleShard, HANDLE_SHARDS>();
+  const auto addr = reinterpret_cast<uintptr_t>(ptr);
+  return shards[((addr >> 4) ^ (addr >> 12)) % HANDLE_SHARDS];
+}
+
+bool derives(uint32_t tag, uint32_t base_tag) {
+  if (tag == base_tag) return true;
+  const auto *ancestors =
+      handle_bases().current.load(std::memory_order_acquire);
+  if (ancestors == nullptr) return false;
+  auto iter = ancestors->find(tag);
+  return iter != ancestors->end() &&
+         std::binary_search(iter->second.begin(), iter->second.end(),
+                            base_tag);
+}
+}  // namespace
+
+void register_handle_base(uint32_t tag, uint32_t base_tag) {
+  auto &reg = handle_bases();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  const auto *current = reg.current.load(std::memory_order_relaxed);
+  auto ancestors = current == nullptr ? HandleAncestors() : *current;
+  // tag and the classes deriving from it gain base_tag and its ancestors
+  std::vector<uint32_t> added = {base_tag};
+  if (auto iter = ancestors.find(base_tag); iter != ancestors.end()) {
+    added.insert(added.end(), iter->second.begin(), iter->second.end());
+  }
+  for (auto &[derived, bases] : ancestors) {
+    if (derived != tag &&
+        !std::binary_search(bases.begin(), bases.end(), tag)) {
+      continue;
+    }
+    bases.insert(bases.end(), added.begin(), added.end());
+  }
+  ancestors.try_emplace(tag, added);
+  for (auto &entry : ancestors) {
+    auto &bases = entry.second;
+    std::sort(bases.begin(), bases.end());
+    bases.erase(std::unique(bases.begin(), bases.end()), bases.end());
+  }
+  reg.current.store(&reg.versions.emplace_back(std::move(ancestors)),
+                    std::memory_order_release);
+}
+
+bool handle_derives(uint32_t tag, uint32_t base_tag) {
+  return derives(tag, base_tag);
+}
+
+void track_handle(const void *ptr, uint32_t tag) {
+  auto &shard = handle_shard(ptr);
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  // its entry in freed_order is skipped when it is evicted
+  shard.freed.erase(ptr);
+  shard.live[ptr] = tag;
+}
+
+void untrack_handle(const void *ptr) {
+  auto &shard = handle_shard(ptr);
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  auto iter = shard.live.find(ptr);
+  if (iter == shard.live.end()) return;
+  shard.live.erase(iter);
+  const auto generation = ++shard.generation;
+  shard.freed[ptr] = generation;
+  shard.freed_order.emplace_back(ptr, generation);
+  while (shard.freed_order.size() > FREED_HANDLES_PER_SHARD) {
+    const auto [old_ptr, old_generation] = shard.freed_order.front();
+    shard.freed_order.pop_front();
+    auto old = shard.freed.find(old_ptr);
+    // not reallocated and freed again since
+    if (old != shard.freed.end() && old->second == old_generation) {
+      shard.freed.erase(old);
+    }
+  }
+}
+
+void check_handle(const void *ptr, uint32_t tag, std::string_view type_name) {
+  uint32_t live_tag;
+  {
+    auto &shard = handle_shard(ptr);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto iter = shard.live.find(ptr);
+    if (iter == shard.live.end()) {
+      if (shard.freed.count(ptr) != 0) {
+        throw std::runtime_error("Handle of a freed object passed as " +
+                                 std::string(type_name));
+      }
+      // not allocated for lisp: a returned reference or a placed object
+      return;
+    }
+    live_tag = iter->second;
+  }
+  if (!derives(live_tag, tag)) {
+    throw std::runtime_error("Handle of another class passed as " +
+                             std::string(type_name));
+  }
+}
+
 char *str_dup(const char *src) {
   try {
     if (src == nullptr) {
@@ -54,8 +284,8 @@ char *str_append(char *old_str, const char *src) {
       size_t len_old = strlen(old_str);
       char *new_str = new char[len + len_old];
       memcpy(new_str, old_str, len_old);
+      memcpy(new_str + len_old, src, len);
       delete[] old_str;
-      strcat(new_str, src);
       return new_str;
     }
     return old_str;
@@ -73,9 +303,16 @@ inline void delete_char_array(char *f) {
 template <>
 void remove_c_strings(ClassInfo obj) {
   delete_char_array(obj.name);
+  delete_char_array(obj.constructors);
   delete_char_array(obj.super_classes);
+  delete_char_array(obj.super_offsets);
   delete_char_array(obj.slot_types);
   delete_char_array(obj.slot_names);
+  delete_char_array(obj.slot_offsets);
+  delete_char_array(obj.slot_sizes);
+  delete_char_array(obj.slot_alignments);
+  delete_char_array(obj.buffer_type);
+  delete_char_array(obj.snapshot_offsets);
 }
 template <>
 void remove_c_strings(FunctionInfo obj) {
@@ -83,14 +320,63 @@ void remove_c_strings(FunctionInfo obj) {
   delete_char_array(obj.class_obj);
   delete_char_array(obj.arg_types);
   delete_char_array(obj.return_type);
+  delete_char_array(obj.overload_tags);
+  delete_char_array(obj.overload_return_types);
 }
 template <>
 void remove_c_strings(ConstantInfo obj) {
   delete_char_array(obj.name);
   delete_char_array(obj.value);
 }
+
+void SnapshotSlots(const void *slot_table, void *obj, void *buffer) {
+  try {
+    for (const auto &slot :
+         *static_cast<const std::vector<SlotAccess> *>(slot_table)) {
+      slot.read(obj, static_cast<char *>(buffer) + slot.offset);
+    }
+  } catch (const std::exception &err) {
+    LispError(err.what());
+  }
+}
+
+void RestoreSlots(const void *slot_table, void *obj, const void *buffer) {
+  try {
+    for (const auto &slot :
+         *static_cast<const std::vector<SlotAccess> *>(slot_table)) {
+      slot.write(obj, static_cast<const char *>(buffer) + slot.offset);
+    }
+  } catch (const std::exception &err) {
+    LispError(err.what());
+  }
+}
+
+std::vector<FuncPtr> class_thunks(const ClassInfo &c_info) {
+  return {c_info.constructor, c_info.destructor, c_info.buffer,
+          c_info.snapshot, c_info.restore, c_info.destruct,
+          c_info.dynamic_class};
+}
 }  // namespace detail
 
+void Package::collect_thunks() {
+  detail::TraceScope trace("collect_thunks");
+  p_thunks.clear();
+  for (const auto &Class : p_classes_meta_data) {
+    for (auto thunk : detail::class_thunks(Class)) {
+      p_thunks.push_back(thunk);
+    }
+  }
+  for (const auto &Func : p_functions_meta_data) {
+    p_thunks.push_back(Func.func_ptr);
+    // methods are shown as Class::name in profiles
+    detail::name_thunk(Func.func_ptr,
+                       Func.class_obj == nullptr
+                           ? Func.name
+                           : (std::string(Func.class_obj) + "::" + Func.name)
+                                 .c_str());
+  }
+}
+
 void PackageRegistry::remove_package(std::string lpack) {
   const auto iter = get_package_iter(lpack);
   auto &pack = *iter->second;
@@ -131,6 +417,16 @@ Package &PackageRegistry::create_package(std::string pack_name) {
   return *p_current_package;
 }
 
+const detail::PackedSignature *PackageRegistry::find_signature(
+    detail::FuncPtr thunk) const {
+  for (const auto &pack : p_packages) {
+    if (const auto *signature = pack.second->packed_signature(thunk)) {
+      return signature;
+    }
+  }
+  return nullptr;
+}
+
 Package &PackageRegistry::current_package() {
   assert(p_current_package != nullptr);
   return *p_current_package;
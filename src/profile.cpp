@@ -0,0 +1,166 @@
+
+#include "clcxx/profile.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "clcxx/clcxx_config.hpp"
+#include "clcxx/memory.hpp"
+
+namespace clcxx {
+
+namespace detail {
+
+namespace {
+struct ThreadTable;
+
+struct ProfileRegistry {
+  std::mutex mutex;
+  std::vector<void (*)()> slots;
+  std::unordered_map<void (*)(), const char *> names;
+  std::vector<ThreadTable *> tables;
+  // counters of exited threads
+  std::deque<ThunkCounters> retired;
+};
+
+ProfileRegistry &profile_registry() {
+  // never destroyed, threads may exit during static destruction
+  static auto &registry = *new ProfileRegistry();
+  return registry;
+}
+
+/// grow under the registry lock, counters never move
+void grow(std::deque<ThunkCounters> &counters, size_t n) {
+  while (counters.size() < n) counters.emplace_back();
+}
+
+void add(ProfileEntry &entry, const ThunkCounters &counters) {
+  entry.calls += counters.calls.load(std::memory_order_relaxed);
+  entry.errors += counters.errors.load(std::memory_order_relaxed);
+  for (size_t b = 0; b < PROFILE_BUCKETS; ++b) {
+    entry.latency[b] += counters.latency[b].load(std::memory_order_relaxed);
+  }
+}
+
+void clear(ThunkCounters &counters) {
+  counters.calls.store(0, std::memory_order_relaxed);
+  counters.errors.store(0, std::memory_order_relaxed);
+  for (auto &bucket : counters.latency) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+void merge(ThunkCounters &into, const ThunkCounters &from) {
+  const auto move_count = [](std::atomic<uint64_t> &to,
+                             const std::atomic<uint64_t> &value) {
+    to.store(to.load(std::memory_order_relaxed) +
+                 value.load(std::memory_order_relaxed),
+             std::memory_order_relaxed);
+  };
+  move_count(into.calls, from.calls);
+  move_count(into.errors, from.errors);
+  for (size_t b = 0; b < PROFILE_BUCKETS; ++b) {
+    move_count(into.latency[b], from.latency[b]);
+  }
+}
+
+struct ThreadTable {
+  ThreadTable() {
+    auto &registry = profile_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.tables.push_back(this);
+  }
+
+  ~ThreadTable() {
+    auto &registry = profile_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    grow(registry.retired, counters.size());
+    for (size_t i = 0; i < counters.size(); ++i) {
+      merge(registry.retired[i], counters[i]);
+    }
+    auto &tables = registry.tables;
+    tables.erase(std::find(tables.begin(), tables.end(), this));
+  }
+
+  std::deque<ThunkCounters> counters;
+};
+
+ThreadTable &thread_table() {
+  thread_local ThreadTable table;
+  return table;
+}
+}  // namespace
+
+size_t profile_slot(void (*thunk)()) {
+  auto &registry = profile_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.slots.push_back(thunk);
+  return registry.slots.size() - 1;
+}
+
+ThunkCounters &thread_counters(size_t slot) {
+  auto &counters = thread_table().counters;
+  if (slot >= counters.size()) {
+    auto &registry = profile_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    grow(counters, slot + 1);
+  }
+  return counters[slot];
+}
+
+void name_thunk(void (*thunk)(), const char *name) {
+  const auto *interned = intern_string(name);
+  auto &registry = profile_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.names[thunk] = interned;
+}
+
+const char *thunk_name(void (*thunk)()) {
+  auto &registry = profile_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  const auto iter = registry.names.find(thunk);
+  return iter == registry.names.end() ? nullptr : iter->second;
+}
+
+}  // namespace detail
+
+size_t ProfileSnapshot(ProfileEntry *entries, size_t n) {
+  auto &registry = detail::profile_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  const auto &slots = registry.slots;
+  for (size_t i = 0; i < n && i < slots.size(); ++i) {
+    auto &entry = entries[i];
+    entry = ProfileEntry{};
+    entry.thunk = slots[i];
+    const auto name = registry.names.find(slots[i]);
+    entry.name = name == registry.names.end() ? nullptr : name->second;
+    if (i < registry.retired.size()) {
+      detail::add(entry, registry.retired[i]);
+    }
+    for (const auto *table : registry.tables) {
+      if (i < table->counters.size()) {
+        detail::add(entry, table->counters[i]);
+      }
+    }
+  }
+  return slots.size();
+}
+
+void ProfileReset() {
+  auto &registry = detail::profile_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (auto &counters : registry.retired) {
+    detail::clear(counters);
+  }
+  for (auto *table : registry.tables) {
+    for (auto &counters : table->counters) {
+      detail::clear(counters);
+    }
+  }
+}
+
+}  // namespace clcxx
@@ -0,0 +1,185 @@
+
+#include "clcxx/trace.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "clcxx/clcxx_config.hpp"
+#include "clcxx/profile.hpp"
+
+namespace clcxx {
+
+namespace detail {
+
+std::atomic<bool> trace_on{false};
+
+namespace {
+struct TraceEvent {
+  // index + 1 of the event once written, 0 while it is being written
+  std::atomic<uint64_t> seq{0};
+  const char *name;
+  void (*thunk)();
+  uint64_t start;
+  uint64_t duration;
+  uint64_t bytes;
+  char phase;
+};
+
+/// written only by its thread, read by dumps
+struct TraceBuffer {
+  explicit TraceBuffer(size_t id) : tid(id), events(TRACE_EVENTS) {}
+
+  void record(const char *name, void (*thunk)(), uint64_t start,
+              uint64_t duration, uint64_t bytes, char phase) {
+    const auto index = head.load(std::memory_order_relaxed);
+    auto &event = events[index % TRACE_EVENTS];
+    event.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name = name;
+    event.thunk = thunk;
+    event.start = start;
+    event.duration = duration;
+    event.bytes = bytes;
+    event.phase = phase;
+    event.seq.store(index + 1, std::memory_order_release);
+    head.store(index + 1, std::memory_order_release);
+  }
+
+  const size_t tid;
+  std::atomic<uint64_t> head{0};
+  std::vector<TraceEvent> events;
+};
+
+struct TraceRegistry {
+  std::mutex mutex;
+  // kept after their thread exits so that its events could be dumped
+  std::vector<std::unique_ptr<TraceBuffer>> buffers;
+  std::chrono::steady_clock::time_point epoch =
+      std::chrono::steady_clock::now();
+};
+
+TraceRegistry &trace_registry() {
+  static auto &registry = *new TraceRegistry();
+  return registry;
+}
+
+TraceBuffer &thread_buffer() {
+  thread_local TraceBuffer *buffer = [] {
+    auto &registry = trace_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.buffers.push_back(
+        std::make_unique<TraceBuffer>(registry.buffers.size() + 1));
+    return registry.buffers.back().get();
+  }();
+  return *buffer;
+}
+
+/// chrome traces count microseconds
+void write_micros(std::ostream &out, uint64_t ns) {
+  out << ns / 1000 << '.' << std::setfill('0') << std::setw(3) << ns % 1000;
+}
+
+void write_json_string(std::ostream &out, const char *str) {
+  out << '"';
+  for (; *str != '\0'; ++str) {
+    if (*str == '"' || *str == '\\') out << '\\';
+    out << *str;
+  }
+  out << '"';
+}
+}  // namespace
+
+uint64_t trace_now() {
+  // never 0, which TraceScope uses for "not recording"
+  return static_cast<uint64_t>(
+             std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now() - trace_registry().epoch)
+                 .count()) +
+         1;
+}
+
+void trace_span(const char *name, void (*thunk)(), uint64_t start_ns) {
+  const auto now = trace_now();
+  thread_buffer().record(name, thunk, start_ns, now - start_ns, 0, 'X');
+}
+
+void trace_instant(const char *name, uint64_t bytes) {
+  thread_buffer().record(name, nullptr, trace_now(), 0, bytes, 'i');
+}
+
+}  // namespace detail
+
+void TraceStart() {
+  detail::trace_on.store(true, std::memory_order_relaxed);
+}
+
+void TraceStop() {
+  detail::trace_on.store(false, std::memory_order_relaxed);
+}
+
+void TraceClear() {
+  auto &registry = detail::trace_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (auto &buffer : registry.buffers) {
+    // only safe while its thread is not recording
+    for (auto &event : buffer->events) {
+      event.seq.store(0, std::memory_order_relaxed);
+    }
+    buffer->head.store(0, std::memory_order_release);
+  }
+}
+
+void TraceDump(const std::string &path) {
+  std::ofstream out(path);
+  if (!out) {
+    throw std::runtime_error("Could not open trace file " + path);
+  }
+  auto &registry = detail::trace_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  auto first = true;
+  for (const auto &buffer : registry.buffers) {
+    const auto head = buffer->head.load(std::memory_order_acquire);
+    const auto begin = head > TRACE_EVENTS ? head - TRACE_EVENTS : 0;
+    for (auto index = begin; index < head; ++index) {
+      const auto &event = buffer->events[index % TRACE_EVENTS];
+      if (event.seq.load(std::memory_order_acquire) != index + 1) continue;
+      const auto copy_name = event.name;
+      const auto copy_thunk = event.thunk;
+      const auto start = event.start;
+      const auto duration = event.duration;
+      const auto bytes = event.bytes;
+      const auto phase = event.phase;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      // overwritten while copying
+      if (event.seq.load(std::memory_order_relaxed) != index + 1) continue;
+      const char *name = copy_name;
+      if (name == nullptr) name = detail::thunk_name(copy_thunk);
+      if (name == nullptr) name = "thunk";
+      out << (first ? "\n" : ",\n") << "{\"name\":";
+      detail::write_json_string(out, name);
+      out << ",\"ph\":\"" << phase << "\",\"pid\":1,\"tid\":" << buffer->tid
+          << ",\"ts\":";
+      detail::write_micros(out, start);
+      if (phase == 'X') {
+        out << ",\"dur\":";
+        detail::write_micros(out, duration);
+      } else {
+        out << ",\"s\":\"t\",\"args\":{\"bytes\":" << bytes << "}";
+      }
+      out << "}";
+      first = false;
+    }
+  }
+  out << "\n]}\n";
+  if (!out) {
+    throw std::runtime_error("Could not write trace file " + path);
+  }
+}
+
+}  // namespace clcxx
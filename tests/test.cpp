@@ -1,10 +1,17 @@
 #include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <algorithm>
 #include <clcxx/clcxx.hpp>
 #include <complex>
+#include <cstddef>
 #include <cstring>
 #include <iostream>
+#include <map>
+#include <numeric>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #define CONFIG_CATCH_MAIN
 
@@ -27,6 +34,17 @@ Pod ManipulatePod(Pod a) {
   return a;
 }
 
+struct BigPod {
+  double v[40];
+  int n;
+};
+
+BigPod ShiftBigPod(BigPod a, double k) {
+  for (auto &x : a.v) x += k;
+  a.n += 1;
+  return a;
+}
+
 double FuncPtrDummy(double x) { return x + 10; }
 double FuncStd(
     const std::function<double(double)> &f) {  // FIXME: don't try this
@@ -48,13 +66,84 @@ class A {
   long int one() const { return 1; }
 };
 
+class Matrix {
+ public:
+  Matrix(size_t r, size_t c) : rows(r), cols(c), data(r * c) {}
+  size_t rows;
+  size_t cols;
+  std::vector<double> data;  // column major
+  const std::vector<double> &values() const { return data; }
+};
+
+class Particle {
+ public:
+  Particle() = default;
+  double mass = 1.5;
+  std::string name = "electron";
+  int id = 7;
+  double spin = 0.5;
+};
+
+struct Shape {
+  virtual ~Shape() = default;
+  double scale = 1.0;
+};
+struct Named {
+  virtual ~Named() = default;
+  int id = 2;
+};
+struct Circle : Shape, Named {
+  double radius = 3.0;
+};
+struct Pooled {
+  int x = 0;
+};
+
 std::string Greet() { return "Hello, World"; }
 int Int(int x) { return x + 100; }
 float Float(const float y) { return y + 100.34; }
 auto ComplexReal(std::complex<float> x) { return real(x); }
 auto ComplexImag(std::complex<float> x) { return imag(x); }
+auto ComplexConj(std::complex<double> x) { return std::conj(x); }
+double SignalPower(clcxx::Span<const std::complex<double>> x) {
+  double p = 0.0;
+  for (const auto &v : x) p += std::norm(v);
+  return p;
+}
+void ScaleSignal(clcxx::Span<std::complex<float>> x, float k) {
+  for (auto &v : x) v *= k;
+}
+size_t CountChar(std::string_view s, char c) {
+  return std::count(s.begin(), s.end(), c);
+}
+std::string Shout(std::string_view s) { return std::string(s) + "!"; }
 std::string Hi(const char *s) { return std::string("hi, " + std::string(s)); }
 
+A MakeA(int x) { return A(x, x + 1); }
+int Twice(int x) { return 2 * x; }
+double Twice(double x) { return 2.0 * x; }
+std::string Twice(const std::string &s) { return s + s; }
+
+int Checked(int x) {
+  if (x < 0) throw std::runtime_error("negative");
+  return x;
+}
+
+double Scale(double x, int k) { return x * k; }
+
+const A *sunk_data = nullptr;
+size_t SinkVector(std::vector<A> v) {
+  sunk_data = v.data();
+  return v.size();
+}
+size_t TakeVector(std::vector<A> &&v) {
+  std::vector<A> taken(std::move(v));
+  return taken.size();
+}
+
+std::string &ParticleName(Particle &p) { return p.name; }
+const std::string &ParticleLabel(const Particle &p) { return p.name; }
+
 void RefInt(int &x) { x += 30; }
 void RefClass(A &x) { x.y = 1000000; }
 
@@ -74,21 +163,100 @@ CLCXX_PACKAGE Test(clcxx::Package &pack) {
       .member("y", &A::y)
       .defmethod("add", F_PTR(&A::add<int>))
       .defmethod("one", F_PTR(&A::one));
-  pack.defun("ref-class", F_PTR(&RefClass));                    // 15
-  pack.defun("lambda1", F_PTR([](A x) { return x.x; }));        // 16
-  pack.defun("create-class", F_PTR([]() { return A(1, 4); }));  // 17
-  pack.defun("dummy", F_PTR(&ReturnPodRef));                    // 18
+  pack.defun("ref-class", F_PTR(&RefClass));                    // 18
+  pack.defun("lambda1", F_PTR([](A x) { return x.x; }));        // 19
+  pack.defun("create-class", F_PTR([]() { return A(1, 4); }));  // 20
+  pack.defun("dummy", F_PTR(&ReturnPodRef));                    // 21
   pack.defcstruct<Pod>("Pod").member("x", &Pod::x).member("y", &Pod::y);
 
-  pack.defun("create-pod", F_PTR(&ReturnPod));      // 19
-  pack.defun("create-pod", F_PTR(&ManipulatePod));  // 20
-  pack.defun("func-ptr", F_PTR(&FuncPtr));          // 21
+  pack.defun("create-pod", F_PTR(&ReturnPod));      // 22
+  pack.defun("create-pod", F_PTR(&ManipulatePod));  // 23
+  pack.defun("func-ptr", F_PTR(&FuncPtr));          // 24
+  pack.defun("complex-conj", F_PTR(&ComplexConj));
+  pack.defun("signal-power", F_PTR(&SignalPower));
+  pack.defun("scale-signal", F_PTR(&ScaleSignal));
+  pack.defcstruct<BigPod>("BigPod").member("n", &BigPod::n);
+  pack.defun("shift-big-pod", F_PTR(&ShiftBigPod));
+  pack.defun("greet-interned", F_PTR(clcxx::interned<&Greet>()));
+  pack.defun("count-char", F_PTR(&CountChar));
+  pack.defun("shout", F_PTR(&Shout));
+  pack.defun("make-a", F_PTR(clcxx::placed<&MakeA>()));
+  pack.defoverload<static_cast<int (*)(int)>(&Twice),
+                   static_cast<double (*)(double)>(&Twice),
+                   static_cast<std::string (*)(const std::string &)>(&Twice)>(
+      "twice");
+  pack.defoverload<&ReturnPod, &ManipulatePod>("make-pod");
+  pack.defclass<Matrix, false>("Matrix")
+      .buffer([](Matrix &m) {
+        return clcxx::Buffer<double>(m.data.data(), {m.rows, m.cols},
+                                     {1, static_cast<ptrdiff_t>(m.rows)});
+      })
+      .defmethod("matrix-values", F_PTR(clcxx::borrowed<&Matrix::values>()));
+  pack.defclass<Particle, true>("Particle")
+      .slab()
+      .member("mass", &Particle::mass)
+      .member("name", &Particle::name)
+      .member<&Particle::id>("id")
+      .member("spin", &Particle::spin);
+  pack.defclass<std::vector<A>, false>("AVector").iterator();
+  pack.defclass<std::map<int, double>, false>("IntMap").iterator().defmap();
+  pack.defclass<std::unordered_map<std::string, double>, false>("StringMap")
+      .defmap();
+  pack.defclass<Shape, false>("Shape");
+  pack.defclass<Named, false>("Named");
+  pack.defclass<Circle, true>("Circle", Shape(), Named());
+  pack.defun("sink-vector", F_PTR(clcxx::consuming<&SinkVector>()));
+  pack.defun("take-vector", F_PTR(&TakeVector));
+  pack.defun("particle-name", F_PTR(clcxx::borrowed<&ParticleName>()));
+  pack.defun("particle-label", F_PTR(&ParticleLabel));
+}
+
+CLCXX_PACKAGE Shapes(clcxx::Package &pack) {
+  pack.defclass<Named, false>("Named");
+  pack.defclass<Shape, false>("Shape");
+  pack.defclass<Circle, true>("Circle", Shape(), Named());
+}
+
+CLCXX_PACKAGE Async(clcxx::Package &pack) {
+  pack.defun("test-int", F_PTR(&Int));
+  pack.defun("shout", F_PTR(&Shout));
+  pack.defun("checked", F_PTR(&Checked));
+  pack.defun("scale", F_PTR(&Scale));
 }
 
 CLCXX_PACKAGE Test2(clcxx::Package &pack) {
   pack.defun("create-pod", F_PTR(&ReturnPod));
 }
 
+/// meta data of the function name in pack, class_name for methods
+clcxx::FunctionInfo &FindFunction(clcxx::Package &pack, std::string_view name,
+                                  std::string_view class_name = "") {
+  auto &functions = pack.functions_meta_data();
+  const auto iter = std::find_if(
+      functions.begin(), functions.end(), [&](const auto &f_info) {
+        // free functions have no class
+        const std::string_view f_class =
+            f_info.class_obj == nullptr ? "" : f_info.class_obj;
+        return f_info.name == name && f_class == class_name;
+      });
+  REQUIRE(iter != functions.end());
+  return *iter;
+}
+
+/// position of the class name in the meta data of pack
+size_t ClassIndex(clcxx::Package &pack, std::string_view name) {
+  auto &classes = pack.classes_meta_data();
+  const auto iter =
+      std::find_if(classes.begin(), classes.end(),
+                   [&](const auto &c_info) { return c_info.name == name; });
+  REQUIRE(iter != classes.end());
+  return static_cast<size_t>(iter - classes.begin());
+}
+
+clcxx::ClassInfo &FindClass(clcxx::Package &pack, std::string_view name) {
+  return pack.classes_meta_data().at(ClassIndex(pack, name));
+}
+
 TEST_CASE("clcxx test", "[clcxx]") {
   // // auto d = clcxx::Import([]() { return &A::one; });
   // constexpr auto f = &A::one;
@@ -144,14 +312,14 @@ TEST_CASE("clcxx test", "[clcxx]") {
     auto f = clcxx::Import([&]() { return &ComplexReal; });
     auto res = std::invoke(reinterpret_cast<decltype(f)>(
                                pack.functions_meta_data().at(4).func_ptr),
-                           clcxx::LispComplex{{7.1f}, {5.1f}});
+                           clcxx::LispComplexFloat{7.1f, 5.1f});
     REQUIRE(res == 7.1f);
   }
   {
     auto f = clcxx::Import([&]() { return &ComplexImag; });
     auto res = std::invoke(reinterpret_cast<decltype(f)>(
                                pack.functions_meta_data().at(5).func_ptr),
-                           clcxx::LispComplex{{7.1f}, {5.1f}});
+                           clcxx::LispComplexFloat{7.1f, 5.1f});
     REQUIRE(res == 5.1f);
   }
   {
@@ -201,7 +369,7 @@ TEST_CASE("clcxx test", "[clcxx]") {
     A a(1, 2);
     auto f = clcxx::Import([&]() { return &RefClass; });
     std::invoke(reinterpret_cast<decltype(f)>(
-                    pack.functions_meta_data().at(15).func_ptr),
+                    pack.functions_meta_data().at(18).func_ptr),
                 (void *)&a);
     REQUIRE(a.x == 1);
     REQUIRE(a.y == 1000000);
@@ -210,7 +378,7 @@ TEST_CASE("clcxx test", "[clcxx]") {
     A a(7, 2);
     auto f = clcxx::Import([]() { return [](A x) { return x.x; }; });
     auto res = std::invoke(reinterpret_cast<decltype(f)>(
-                               pack.functions_meta_data().at(16).func_ptr),
+                               pack.functions_meta_data().at(19).func_ptr),
                            (void *)&a);
     REQUIRE(res == 7);
   }
@@ -218,7 +386,7 @@ TEST_CASE("clcxx test", "[clcxx]") {
     Pod a{1, 3.5};
     auto f = clcxx::Import([]() { return &ReturnPod; });
     auto res = std::invoke(reinterpret_cast<decltype(f)>(
-        pack.functions_meta_data().at(19).func_ptr));
+        pack.functions_meta_data().at(22).func_ptr));
     REQUIRE(res.x == a.x);
     REQUIRE(res.y == a.y);
   }
@@ -226,7 +394,7 @@ TEST_CASE("clcxx test", "[clcxx]") {
     Pod a{1, 3.5};
     auto f = clcxx::Import([]() { return &ManipulatePod; });
     auto res = std::invoke(reinterpret_cast<decltype(f)>(
-                               pack.functions_meta_data().at(20).func_ptr),
+                               pack.functions_meta_data().at(23).func_ptr),
                            a);
     REQUIRE(res.x == a.x + 10);
     REQUIRE(res.y == a.y + 10);
@@ -234,13 +402,587 @@ TEST_CASE("clcxx test", "[clcxx]") {
   {
     auto f = clcxx::Import([]() { return &FuncPtr; });
     auto res = std::invoke(reinterpret_cast<decltype(f)>(
-                               pack.functions_meta_data().at(21).func_ptr),
+                               pack.functions_meta_data().at(24).func_ptr),
                            (void (*)())FuncPtrDummy);
     REQUIRE(res == FuncPtr(FuncPtrDummy));
   }
 
+  {
+    auto f = clcxx::Import([]() { return &ComplexConj; });
+    auto res = std::invoke(reinterpret_cast<decltype(f)>(
+                               FindFunction(pack, "complex-conj").func_ptr),
+                           clcxx::LispComplexDouble{1.5, 2.5});
+    REQUIRE(res.real == 1.5);
+    REQUIRE(res.imag == -2.5);
+    REQUIRE(sizeof(clcxx::ToLisp_t<std::complex<float>>) == 8);
+  }
+  {
+    std::vector<std::complex<double>> x = {{1.0, 1.0}, {2.0, 0.0}};
+    auto f = clcxx::Import([]() { return &SignalPower; });
+    auto res = std::invoke(reinterpret_cast<decltype(f)>(
+                               FindFunction(pack, "signal-power").func_ptr),
+                           clcxx::LispSpan{x.data(), x.size()});
+    REQUIRE(res == 6.0);
+    REQUIRE(strcmp(FindFunction(pack, "signal-power").arg_types,
+                   "(:span (:complex :double))+") == 0);
+  }
+  {
+    std::complex<float> x[3] = {{1.0f, 2.0f}, {0.5f, 0.0f}, {0.0f, 1.0f}};
+    auto f = clcxx::Import([]() { return &ScaleSignal; });
+    std::invoke(reinterpret_cast<decltype(f)>(
+                    FindFunction(pack, "scale-signal").func_ptr),
+                clcxx::LispSpan{x, 3}, 2.0f);
+    REQUIRE(x[0] == std::complex<float>(2.0f, 4.0f));
+    REQUIRE(x[2] == std::complex<float>(0.0f, 2.0f));
+  }
+  {
+    BigPod a{};
+    a.v[39] = 1.0;
+    a.n = 2;
+    BigPod res{};
+    auto &f_info = FindFunction(pack, "shift-big-pod");
+    REQUIRE(f_info.out_return_p);
+    REQUIRE(strcmp(f_info.arg_types,
+                   "(:const-reference (:struct BigPod))+:double+") == 0);
+    reinterpret_cast<void (*)(void *, const void *, double)>(f_info.func_ptr)(
+        &res, &a, 2.0);
+    REQUIRE(res.v[0] == 2.0);
+    REQUIRE(res.v[39] == 3.0);
+    REQUIRE(res.n == 3);
+    REQUIRE_FALSE(FindFunction(pack, "create-pod").out_return_p);
+  }
+  {
+    Matrix m(3, 2);
+    m.data[4] = 5.0;
+    auto &c_info = FindClass(pack, "Matrix");
+    REQUIRE(strcmp(c_info.buffer_type, ":double") == 0);
+    clcxx::BufferInfo info;
+    reinterpret_cast<void (*)(void *, clcxx::BufferInfo *)>(c_info.buffer)(
+        (void *)&m, &info);
+    REQUIRE(info.data == m.data.data());
+    REQUIRE(info.item_size == sizeof(double));
+    REQUIRE(info.ndim == 2);
+    REQUIRE(info.shape[0] == 3);
+    REQUIRE(info.shape[1] == 2);
+    REQUIRE(static_cast<double *>(info.data)[1 * info.strides[0] +
+                                             1 * info.strides[1]] == 5.0);
+    REQUIRE(FindClass(pack, "A").buffer == nullptr);
+  }
+
+  {
+    auto &a_info = FindClass(pack, "A");
+    REQUIRE(std::string(a_info.slot_offsets) ==
+            std::to_string(offsetof(A, y)) + "+");
+    REQUIRE(strcmp(a_info.slot_sizes, "4+") == 0);
+    auto &pod_info = FindClass(pack, "Pod");
+    REQUIRE(std::string(pod_info.slot_offsets) ==
+            std::to_string(offsetof(Pod, x)) + "+" +
+                std::to_string(offsetof(Pod, y)) + "+");
+    REQUIRE(strcmp(pod_info.slot_alignments, "4+4+") == 0);
+  }
+
+  {
+    Particle p, q;
+    q.mass = 0.0;
+    q.name = "";
+    q.id = 0;
+    q.spin = 0.0;
+    auto &c_info = FindClass(pack, "Particle");
+    std::vector<std::max_align_t> buffer(
+        c_info.snapshot_size / sizeof(std::max_align_t) + 1);
+    REQUIRE(c_info.snapshot_size == 4 * sizeof(double));
+    REQUIRE(strcmp(c_info.snapshot_offsets, "0+8+16+24+") == 0);
+    REQUIRE(class_slot_table("test", "Particle") == c_info.slot_table);
+    reinterpret_cast<void (*)(const void *, void *, void *)>(c_info.snapshot)(
+        c_info.slot_table, (void *)&p, buffer.data());
+    auto raw = reinterpret_cast<char *>(buffer.data());
+    auto name = *reinterpret_cast<char **>(raw + 8);
+    REQUIRE(*reinterpret_cast<double *>(raw) == 1.5);
+    REQUIRE(strcmp(name, "electron") == 0);
+    REQUIRE(*reinterpret_cast<int *>(raw + 16) == 7);
+    reinterpret_cast<void (*)(const void *, void *, const void *)>(
+        c_info.restore)(c_info.slot_table, (void *)&q, buffer.data());
+    REQUIRE(q.mass == 1.5);
+    REQUIRE(q.name == "electron");
+    REQUIRE(q.id == 7);
+    REQUIRE(q.spin == 0.5);
+    delete_string(name);
+  }
+
+  {
+    auto &f_info = FindFunction(pack, "greet-interned");
+    REQUIRE(strcmp(f_info.return_type, ":string") == 0);
+    auto f = clcxx::Import([&]() { return clcxx::interned<&Greet>(); });
+    auto greet = reinterpret_cast<decltype(f)>(f_info.func_ptr);
+    const char *s1 = greet();
+    REQUIRE(strcmp(s1, "Hello, World") == 0);
+    REQUIRE(greet() == s1);
+    REQUIRE(clcxx::intern_string("Hello, World") == s1);
+  }
+  {
+    auto &a_info = FindClass(pack, "A");
+    REQUIRE(a_info.size == sizeof(A));
+    REQUIRE(a_info.alignment == alignof(A));
+    alignas(A) unsigned char storage[sizeof(A)];
+    auto &ctor_info = FindFunction(pack, "create-A2-at", "A");
+    auto construct = reinterpret_cast<void *(*)(void *, int, int)>(
+        ctor_info.func_ptr);
+    auto destruct = reinterpret_cast<void (*)(void *)>(a_info.destruct);
+    auto a = static_cast<A *>(construct(storage, 3, 5));
+    REQUIRE(static_cast<void *>(a) == storage);
+    REQUIRE(a->y == 5);
+    destruct(a);
+
+    auto &f_info = FindFunction(pack, "make-a");
+    REQUIRE(f_info.out_return_p);
+    REQUIRE(strcmp(f_info.return_type, "(:class A)") == 0);
+    reinterpret_cast<void (*)(void *, int)>(f_info.func_ptr)(storage, 8);
+    REQUIRE(a->x == 8);
+    REQUIRE(a->y == 9);
+    destruct(a);
+  }
+  {
+    auto &f_info = FindFunction(pack, "twice");
+    using Dispatch = void (*)(uint64_t, void **, void *);
+    auto twice = reinterpret_cast<Dispatch>(f_info.func_ptr);
+    // arity 1, codes integer = 1, real = 2, string = 4
+    REQUIRE(strcmp(f_info.overload_tags, "17+33+65+") == 0);
+    REQUIRE(strcmp(f_info.overload_return_types,
+                   ":int32+:double+:string+ptr+") == 0);
+    int64_t i = 21;
+    void *int_args[] = {&i};
+    int int_res = 0;
+    twice(17, int_args, &int_res);
+    REQUIRE(int_res == 42);
+    double d = 1.25;
+    void *double_args[] = {&d};
+    double double_res = 0;
+    twice(33, double_args, &double_res);
+    REQUIRE(double_res == 2.5);
+    const char *str = "ab";
+    void *str_args[] = {&str};
+    const char *str_res = nullptr;
+    twice(65, str_args, &str_res);
+    REQUIRE(strcmp(str_res, "abab") == 0);
+    delete_string(const_cast<char *>(str_res));
+
+    auto make_pod = reinterpret_cast<Dispatch>(
+        FindFunction(pack, "make-pod").func_ptr);
+    Pod pod{1, 2.5}, pod_res{};
+    make_pod(0, nullptr, &pod_res);
+    REQUIRE(pod_res.x == 1);
+    void *pod_args[] = {&pod};
+    make_pod(1 + (6 << 4), pod_args, &pod_res);
+    REQUIRE(pod_res.x == 11);
+  }
+  {
+    // views aren't NUL terminated
+    const char text[] = {'a', 'b', 'a', 'a'};
+    clcxx::LispStringView view{text, 3};
+    auto &f_info = FindFunction(pack, "count-char");
+    REQUIRE(strcmp(f_info.arg_types, ":string-view+:char+") == 0);
+    auto count = clcxx::Import([&]() { return &CountChar; });
+    REQUIRE(std::invoke(reinterpret_cast<decltype(count)>(f_info.func_ptr),
+                        view, 'a') == 2);
+    // the length is passed, embedded NULs are part of the view
+    const char with_nul[] = {'a', '\0', 'a', '\0', 'a'};
+    clcxx::LispStringView nul_view{with_nul, 4};
+    REQUIRE(std::invoke(reinterpret_cast<decltype(count)>(f_info.func_ptr),
+                        nul_view, '\0') == 2);
+    REQUIRE(std::invoke(reinterpret_cast<decltype(count)>(f_info.func_ptr),
+                        nul_view, 'a') == 2);
+    auto shout = clcxx::Import([&]() { return &Shout; });
+    auto res = std::invoke(reinterpret_cast<decltype(shout)>(
+                               FindFunction(pack, "shout").func_ptr),
+                           view);
+    REQUIRE(strcmp(res, "aba!") == 0);
+    delete_string(const_cast<char *>(res));
+    // only std::string_view opts in, string references keep their mapping
+    REQUIRE(clcxx::internal::static_type_mapping<
+                const std::string &>::lisp_type() ==
+            "(:const-reference :string+ptr)");
+  }
+  {
+    Particle p, q;
+    q.mass = 3.0;
+    q.id = 9;
+    void *objs[] = {&p, &q};
+    double mass[2];
+    reinterpret_cast<void (*)(void **, size_t, double *)>(
+        FindFunction(pack, "mass.gather", "Particle").func_ptr)(objs, 2, mass);
+    REQUIRE(mass[0] == 1.5);
+    REQUIRE(mass[1] == 3.0);
+    // same type as mass, bound with its own thunks
+    double spin[2];
+    q.spin = -0.5;
+    reinterpret_cast<void (*)(void **, size_t, double *)>(
+        FindFunction(pack, "spin.gather", "Particle").func_ptr)(objs, 2, spin);
+    REQUIRE(spin[0] == 0.5);
+    REQUIRE(spin[1] == -0.5);
+    int ids[] = {11, 12};
+    reinterpret_cast<void (*)(void **, size_t, const int *)>(
+        FindFunction(pack, "id.scatter", "Particle").func_ptr)(objs, 2, ids);
+    REQUIRE(p.id == 11);
+    REQUIRE(q.id == 12);
+    using IdMember = clcxx::detail::FixedMember<&Particle::id>;
+    auto get_id = clcxx::Import(
+        [&]() { return &clcxx::detail::GetMember<Particle, IdMember>; });
+    REQUIRE(std::invoke(reinterpret_cast<decltype(get_id)>(
+                            FindFunction(pack, "id.get", "Particle").func_ptr),
+                        (void *)&q) == 12);
+  }
+
+  {
+    std::vector<A> vec = {A(1, 2), A(3, 4), A(5, 6)};
+    auto begin = reinterpret_cast<void *(*)(void *)>(
+        FindFunction(pack, "iter.begin", "AVector").func_ptr);
+    auto next = reinterpret_cast<size_t (*)(void *, size_t, void **)>(
+        FindFunction(pack, "iter.next-chunk", "AVector").func_ptr);
+    auto end = reinterpret_cast<void (*)(void *)>(
+        FindFunction(pack, "iter.end", "AVector").func_ptr);
+    auto cursor = begin(&vec);
+    void *objs[2];
+    REQUIRE(next(cursor, 2, objs) == 2);
+    REQUIRE(static_cast<A *>(objs[1])->y == 4);
+    clcxx::detail::free_obj_ptr<A>(objs[0]);
+    clcxx::detail::free_obj_ptr<A>(objs[1]);
+    REQUIRE(next(cursor, 2, objs) == 1);
+    REQUIRE(static_cast<A *>(objs[0])->x == 5);
+    clcxx::detail::free_obj_ptr<A>(objs[0]);
+    REQUIRE(next(cursor, 2, objs) == 0);
+    end(cursor);
+
+    std::map<int, double> map = {{1, 0.5}, {2, 1.5}};
+    cursor = reinterpret_cast<void *(*)(void *)>(
+        FindFunction(pack, "iter.begin", "IntMap").func_ptr)(&map);
+    int keys[4];
+    double values[4];
+    REQUIRE(reinterpret_cast<size_t (*)(void *, size_t, int *, double *)>(
+                FindFunction(pack, "iter.next-chunk", "IntMap").func_ptr)(
+                cursor, 4, keys, values) == 2);
+    REQUIRE(keys[1] == 2);
+    REQUIRE(values[1] == 1.5);
+    reinterpret_cast<void (*)(void *)>(
+        FindFunction(pack, "iter.end", "IntMap").func_ptr)(cursor);
+  }
+
+  {
+    std::unordered_map<std::string, double> map;
+    const char *keys[] = {"one", "two", "three"};
+    double values[] = {1.0, 2.0, 3.0};
+    reinterpret_cast<void (*)(void *, const char **, double *, size_t)>(
+        FindFunction(pack, "map.insert", "StringMap").func_ptr)(&map, keys,
+                                                                values, 3);
+    REQUIRE(map.at("two") == 2.0);
+    REQUIRE(reinterpret_cast<size_t (*)(void *, const char **, size_t)>(
+                FindFunction(pack, "map.erase", "StringMap").func_ptr)(
+                &map, keys, 1) == 1);
+    double found_values[3];
+    bool found[3];
+    reinterpret_cast<void (*)(void *, const char **, size_t, double *,
+                              bool *)>(
+        FindFunction(pack, "map.find", "StringMap").func_ptr)(
+        &map, keys, 3, found_values, found);
+    REQUIRE_FALSE(found[0]);
+    REQUIRE(found[2]);
+    REQUIRE(found_values[2] == 3.0);
+
+    std::map<int, double> int_map = {{1, 0.5}};
+    int int_keys[] = {2, 1};
+    reinterpret_cast<void (*)(void *, const int *, size_t, double *,
+                              bool *)>(
+        FindFunction(pack, "map.find", "IntMap").func_ptr)(
+        &int_map, int_keys, 2, found_values, found);
+    REQUIRE_FALSE(found[0]);
+    REQUIRE(found_values[1] == 0.5);
+  }
+
+  {
+    REQUIRE(reserve_objects("test", "Particle", 64));
+    auto &slab = clcxx::type_slab<Particle>();
+    REQUIRE(slab.free_blocks() >= 64);
+    auto &c_info = FindClass(pack, "Particle");
+    auto create = reinterpret_cast<void *(*)()>(c_info.constructor);
+    auto destroy = reinterpret_cast<void (*)(void *)>(c_info.destructor);
+    auto p = static_cast<Particle *>(create());
+    auto q = static_cast<Particle *>(create());
+    REQUIRE(reinterpret_cast<char *>(q) - reinterpret_cast<char *>(p) ==
+            static_cast<ptrdiff_t>(slab.block_size()));
+    REQUIRE(q->name == "electron");
+    const auto free_blocks = slab.free_blocks();
+    destroy(p);
+    destroy(q);
+    REQUIRE(slab.free_blocks() == free_blocks + 2);
+  }
+
+  {
+    auto &circle_info = FindClass(pack, "Circle");
+    REQUIRE(strcmp(circle_info.super_classes, "Shape+Named+") == 0);
+    Circle circle;
+    Named *named = &circle;
+    const auto named_offset =
+        reinterpret_cast<char *>(named) - reinterpret_cast<char *>(&circle);
+    REQUIRE(std::string(circle_info.super_offsets) ==
+            "0+" + std::to_string(named_offset) + "+");
+    REQUIRE(FindClass(pack, "A").dynamic_class == nullptr);
+    REQUIRE(strcmp(FindClass(pack, "A").constructors, "create-A2+") == 0);
+    auto &named_info = FindClass(pack, "Named");
+    void *most_derived = nullptr;
+    auto dynamic_class =
+        reinterpret_cast<int64_t (*)(const void *, void *, void **)>(
+            named_info.dynamic_class);
+    REQUIRE(class_index_table("test") == &pack.class_indexes());
+    REQUIRE(dynamic_class(&pack.class_indexes(), named, &most_derived) ==
+            static_cast<int64_t>(ClassIndex(pack, "Circle")));
+    REQUIRE(most_derived == static_cast<void *>(&circle));
+  }
+
   REQUIRE_NOTHROW(clcxx::registry().remove_package("test"));
   REQUIRE_THROWS(clcxx::registry().remove_package("test"));
 
   REQUIRE_THROWS(Test2(pack));
 }
+
+TEST_CASE("thunk table", "[clcxx]") {
+  REQUIRE(load_package("test-thunks", Test));
+  REQUIRE_FALSE(clcxx::registry().has_current_package());
+  const auto n = package_thunks("test-thunks", nullptr, 0);
+  std::vector<void (*)()> thunks(n);
+  REQUIRE(package_thunks("test-thunks", thunks.data(), n) == n);
+  // the thunks of the classes then of the functions, in the order of the
+  // meta data, which load_package released
+  clcxx::Package &layout = clcxx::registry().create_package("test-layout");
+  Test(layout);
+  const auto class_thunks =
+      clcxx::detail::class_thunks(clcxx::ClassInfo{}).size();
+  const auto class_thunk = [&](const char *class_name, size_t i) {
+    return thunks.at(ClassIndex(layout, class_name) * class_thunks + i);
+  };
+  const auto function_index = static_cast<size_t>(
+      &FindFunction(layout, "test-int") - layout.functions_meta_data().data());
+  auto f = clcxx::Import([&]() { return &Int; });
+  auto res = std::invoke(
+      reinterpret_cast<decltype(f)>(thunks.at(
+          layout.classes_meta_data().size() * class_thunks + function_index)),
+      (int)7);
+  REQUIRE(res == 107);
+  // slot tables outlive the released meta data
+  Particle p;
+  std::vector<std::max_align_t> buffer(4);
+  auto snapshot = reinterpret_cast<void (*)(const void *, void *, void *)>(
+      class_thunk("Particle", 3));
+  snapshot(class_slot_table("test-thunks", "Particle"), &p, buffer.data());
+  REQUIRE(*reinterpret_cast<double *>(buffer.data()) == 1.5);
+  delete_string(
+      *reinterpret_cast<char **>(reinterpret_cast<char *>(buffer.data()) + 8));
+  // class indexes are looked up in the package passed in
+  clcxx::Package &shapes = clcxx::registry().create_package("test-shapes");
+  Shapes(shapes);
+  const auto shapes_circle = static_cast<int64_t>(ClassIndex(shapes, "Circle"));
+  REQUIRE_NOTHROW(clcxx::registry().remove_package("test-shapes"));
+  REQUIRE(load_package("test-shapes", Shapes));
+  auto dynamic_class =
+      reinterpret_cast<int64_t (*)(const void *, void *, void **)>(
+          class_thunk("Named", 6));
+  Circle circle;
+  Named *named = &circle;
+  REQUIRE(dynamic_class(class_index_table("test-thunks"), named, nullptr) ==
+          static_cast<int64_t>(ClassIndex(layout, "Circle")));
+  REQUIRE(dynamic_class(class_index_table("test-shapes"), named, nullptr) ==
+          shapes_circle);
+  REQUIRE(shapes_circle != static_cast<int64_t>(ClassIndex(layout, "Circle")));
+  REQUIRE_NOTHROW(clcxx::registry().remove_package("test-shapes"));
+  // slabs can be reserved after the meta data is released
+  static std::string error;
+  clcxx::registry().set_error_handler([](char *msg) { error = msg; });
+  REQUIRE(reserve_objects("test-thunks", "Particle", 128));
+  REQUIRE(clcxx::type_slab<Particle>().free_blocks() >= 128);
+  REQUIRE_FALSE(reserve_objects("test-thunks", "A", 8));
+  REQUIRE(error.find("has no slab") != std::string::npos);
+  REQUIRE_FALSE(reserve_objects("test-thunks", "Missing", 8));
+  REQUIRE(error.find("was not found") != std::string::npos);
+  REQUIRE_NOTHROW(clcxx::registry().remove_package("test-layout"));
+  REQUIRE_NOTHROW(clcxx::registry().remove_package("test-thunks"));
+}
+
+TEST_CASE("async calls", "[clcxx]") {
+  // packed signatures are recorded when a package is registered
+  REQUIRE(load_package("test-async", Async));
+  REQUIRE(set_async_threads(2));
+  auto int_thunk =
+      reinterpret_cast<void (*)()>(clcxx::Import([&]() { return &Int; }));
+  auto x = 7;
+  void *int_args[] = {&x};
+  auto handle = async_call(int_thunk, int_args);
+  REQUIRE(handle != nullptr);
+  x = 0;  // arguments are copied on submission
+  REQUIRE(async_wait(handle, -1) == static_cast<int>(clcxx::AsyncState::done));
+  REQUIRE(async_poll(handle) == static_cast<int>(clcxx::AsyncState::done));
+  REQUIRE_FALSE(async_cancel(handle));
+  auto res = 0;
+  REQUIRE(async_collect(handle, &res));
+  REQUIRE(res == 107);
+  async_release(handle);
+
+  // a replaced pool lives on while it is held
+  auto old_pool = clcxx::AsyncPool();
+  REQUIRE(set_async_threads(3));
+  REQUIRE(clcxx::AsyncPool()->size() == 3);
+  auto old_pool_ran = false;
+  old_pool->submit([&old_pool_ran] { old_pool_ran = true; });
+  old_pool.reset();
+  REQUIRE(old_pool_ran);
+
+  auto shout_thunk =
+      reinterpret_cast<void (*)()>(clcxx::Import([&]() { return &Shout; }));
+  const std::string text = "hey";
+  auto view = clcxx::LispStringView{text.data(), text.size()};
+  void *shout_args[] = {&view};
+  handle = async_call(shout_thunk, shout_args);
+  async_wait(handle, -1);
+  char *shouted = nullptr;
+  REQUIRE(async_collect(handle, &shouted));
+  REQUIRE(std::string(shouted) == "hey!");
+  REQUIRE(delete_string(shouted));
+  async_release(handle);
+
+  auto checked_thunk =
+      reinterpret_cast<void (*)()>(clcxx::Import([&]() { return &Checked; }));
+  const auto *signature = clcxx::detail::find_signature(checked_thunk);
+  REQUIRE(signature != nullptr);
+  REQUIRE(signature->arg_sizes == std::vector<size_t>{sizeof(int)});
+  REQUIRE(signature->result_size == sizeof(int));
+  auto y = -1;
+  void *checked_args[] = {&y};
+  clcxx::AsyncCall failing(*signature, checked_args);
+  failing.run();
+  REQUIRE(failing.wait(0) == clcxx::AsyncState::failed);
+  REQUIRE_THROWS(failing.collect(&res));
+
+  clcxx::AsyncCall cancelled(*signature, checked_args);
+  REQUIRE(cancelled.cancel());
+  cancelled.run();
+  REQUIRE(cancelled.state() == clcxx::AsyncState::cancelled);
+  REQUIRE_THROWS(cancelled.collect(&res));
+
+  REQUIRE_NOTHROW(clcxx::registry().remove_package("test-async"));
+  REQUIRE(clcxx::detail::find_signature(checked_thunk) == nullptr);
+}
+
+TEST_CASE("parallel map", "[clcxx]") {
+  REQUIRE(load_package("test-map", Async));
+  auto scale_thunk =
+      reinterpret_cast<void (*)()>(clcxx::Import([&]() { return &Scale; }));
+  const size_t n = 10000;
+  std::vector<double> xs(n);
+  std::iota(xs.begin(), xs.end(), 0.0);
+  std::vector<int> ks(n, 3);
+  std::vector<double> out(n);
+  void *columns[] = {xs.data(), ks.data()};
+  REQUIRE(parallel_map(scale_thunk, columns, out.data(), n, 4));
+  std::vector<double> expected(n);
+  std::transform(xs.begin(), xs.end(), expected.begin(),
+                 [](double x) { return 3.0 * x; });
+  REQUIRE(out == expected);
+  // one thread and fewer elements than threads
+  REQUIRE(parallel_map(scale_thunk, columns, out.data(), 3, 1));
+  REQUIRE(parallel_map(scale_thunk, columns, out.data(), 2, 8));
+  REQUIRE(out[1] == 3.0);
+
+  auto checked_thunk =
+      reinterpret_cast<void (*)()>(clcxx::Import([&]() { return &Checked; }));
+  std::vector<int> ys(n, 1);
+  ys[n / 2] = -1;
+  std::vector<int> checked(n);
+  void *checked_columns[] = {ys.data()};
+  REQUIRE_THROWS_WITH(
+      clcxx::ParallelMap(*clcxx::detail::find_signature(checked_thunk),
+                         checked_columns, checked.data(), n, 4),
+      "negative");
+  REQUIRE_NOTHROW(clcxx::registry().remove_package("test-map"));
+}
+
+TEST_CASE("slab of a class with live objects", "[clcxx]") {
+  const auto bind_slab = [](const char *name) {
+    clcxx::Package &pack = clcxx::registry().create_package(name);
+    pack.defclass<Pooled, false>("Pooled").slab();
+  };
+  auto pooled = clcxx::allocate_object<Pooled>();
+  REQUIRE_THROWS(bind_slab("test-slab"));
+  clcxx::deallocate_object<Pooled>(pooled);
+  REQUIRE_NOTHROW(bind_slab("test-slab2"));
+  REQUIRE(clcxx::object_resource<Pooled>() == &clcxx::type_slab<Pooled>());
+
+  // objects allocated from the slab don't stop other packages binding it
+  pooled = clcxx::allocate_object<Pooled>();
+  REQUIRE_NOTHROW(bind_slab("test-slab3"));
+  clcxx::deallocate_object<Pooled>(pooled);
+  for (const auto name : {"test-slab", "test-slab2", "test-slab3"}) {
+    REQUIRE_NOTHROW(clcxx::registry().remove_package(name));
+  }
+}
+
+TEST_CASE("moved arguments", "[clcxx]") {
+  clcxx::Package &pack = clcxx::registry().create_package("test-move");
+  Test(pack);
+  REQUIRE(std::string(FindFunction(pack, "take-vector").arg_types) ==
+          "(:rvalue-reference (:class AVector))+");
+  REQUIRE(std::string(FindFunction(pack, "sink-vector").arg_types) ==
+          "(:rvalue-reference (:class AVector))+");
+
+  const std::vector<A> values(3, A(1, 2));
+  auto make_vector =
+      clcxx::Import([&]() { return [&values]() { return values; }; });
+  using Thunk = size_t (*)(void *);
+  auto v = make_vector();
+  auto take =
+      reinterpret_cast<Thunk>(FindFunction(pack, "take-vector").func_ptr);
+  REQUIRE(take(v) == 3);
+  REQUIRE(static_cast<std::vector<A> *>(v)->empty());
+
+  // the by-value argument is moved out of the handle, storage isn't copied
+  auto sink =
+      reinterpret_cast<Thunk>(FindFunction(pack, "sink-vector").func_ptr);
+  auto w = make_vector();
+  auto data = static_cast<std::vector<A> *>(w)->data();
+  REQUIRE(sink(w) == 3);
+  REQUIRE(sunk_data == data);
+  REQUIRE(static_cast<std::vector<A> *>(w)->empty());
+  REQUIRE(sink(w) == 0);
+
+  clcxx::detail::free_obj_ptr<std::vector<A>>(v);
+  clcxx::detail::free_obj_ptr<std::vector<A>>(w);
+  REQUIRE_NOTHROW(clcxx::registry().remove_package("test-move"));
+}
+
+TEST_CASE("borrowed results", "[clcxx]") {
+  clcxx::Package &pack = clcxx::registry().create_package("test-borrow");
+  Test(pack);
+  auto values = FindFunction(pack, "matrix-values", "Matrix");
+  REQUIRE(std::string(values.arg_types) ==
+          "(:const-reference (:class Matrix))+");
+  REQUIRE(std::string(values.return_type) == "(:span :double)");
+  REQUIRE(std::string(FindFunction(pack, "particle-name").return_type) ==
+          ":string-view");
+  // borrowing is opt-in, without the wrapper string references keep
+  // their mapping, a pointer to the std::string
+  REQUIRE(std::string(FindFunction(pack, "particle-label").return_type) ==
+          "(:const-reference :string+ptr)");
+
+  Matrix m(2, 3);
+  m.data[4] = 2.5;
+  auto span = reinterpret_cast<clcxx::LispSpan (*)(const void *)>(
+      values.func_ptr)(&m);
+  REQUIRE(span.data == m.data.data());
+  REQUIRE(span.size == 6);
+
+  Particle p;
+  auto name = reinterpret_cast<clcxx::LispStringView (*)(void *)>(
+      FindFunction(pack, "particle-name").func_ptr)(&p);
+  REQUIRE(name.data == p.name.data());
+  REQUIRE(std::string_view(name.data, name.size) == "electron");
+  auto label = reinterpret_cast<const void *(*)(const void *)>(
+      FindFunction(pack, "particle-label").func_ptr)(&p);
+  REQUIRE(label == &p.name);
+  REQUIRE_NOTHROW(clcxx::registry().remove_package("test-borrow"));
+}
@@ -0,0 +1,110 @@
+#define CLCXX_CHECKED_HANDLES 1
+
+#include <catch2/catch_test_macros.hpp>
+#include <clcxx/clcxx.hpp>
+#include <string>
+#include <vector>
+
+class A {
+ public:
+  A(int A, int yy) : y(yy), x(A) {}
+  int y;
+  int x;
+};
+
+class Particle {
+ public:
+  Particle() = default;
+  double mass = 1.5;
+};
+
+struct Shape {
+  virtual ~Shape() = default;
+  double scale = 1.0;
+};
+struct Named {
+  virtual ~Named() = default;
+  int id = 2;
+};
+struct Circle : Shape, Named {
+  double radius = 3.0;
+};
+struct Ring : Circle {
+  double inner = 1.0;
+};
+
+void RefClass(A &x) { x.y = 1000000; }
+
+CLCXX_PACKAGE Handles(clcxx::Package &pack) {
+  pack.defclass<A, false>("A").constructor<int, int>();
+  pack.defun("ref-class", F_PTR(&RefClass));
+  pack.defclass<Particle, true>("Particle").slab();
+  pack.defclass<Shape, false>("Shape");
+  pack.defclass<Named, false>("Named");
+  pack.defclass<Circle, true>("Circle", Shape(), Named());
+  pack.defclass<Ring, true>("Ring", Circle());
+}
+
+TEST_CASE("checked handles", "[clcxx]") {
+  static std::string error;
+  clcxx::registry().set_error_handler([](char *msg) { error = msg; });
+  REQUIRE(load_package("test-handles", Handles));
+  auto make_a = clcxx::Import([]() { return []() { return A(2, 3); }; });
+  auto make_particle =
+      clcxx::Import([]() { return []() { return Particle(); }; });
+  auto make_circle = clcxx::Import([]() { return []() { return Circle(); }; });
+  auto ref_class = clcxx::Import([]() { return &RefClass; });
+  auto scale =
+      clcxx::Import([]() { return [](const Shape &s) { return s.scale; }; });
+
+  error.clear();
+  auto a = make_a();
+  ref_class(a);
+  REQUIRE(error.empty());
+  REQUIRE(static_cast<A *>(a)->y == 1000000);
+
+  auto particle = make_particle();
+  ref_class(particle);
+  REQUIRE(error.find("another class") != std::string::npos);
+
+  // derived objects at offset 0 pass as their base class
+  error.clear();
+  auto circle = make_circle();
+  REQUIRE(scale(circle) == 1.0);
+  REQUIRE(error.empty());
+  // and as the bases of their base class
+  auto make_ring = clcxx::Import([]() { return []() { return Ring(); }; });
+  auto ring = make_ring();
+  REQUIRE(scale(ring) == 1.0);
+  REQUIRE(error.empty());
+  clcxx::detail::free_obj_ptr<Ring>(ring);
+
+  // borrowed pointers aren't in the handle tables and aren't checked
+  A local(1, 2);
+  ref_class(&local);
+  REQUIRE(error.empty());
+  REQUIRE(local.y == 1000000);
+
+  clcxx::detail::free_obj_ptr<A>(a);
+  ref_class(a);
+  REQUIRE(error.find("freed") != std::string::npos);
+
+  // a new object in freed memory is live again
+  error.clear();
+  auto b = make_a();
+  ref_class(b);
+  REQUIRE(error.empty());
+  clcxx::detail::free_obj_ptr<A>(b);
+
+  // the oldest freed handles are forgotten first, recent ones are kept
+  std::vector<void *> handles(2 * CLCXX_FREED_HANDLES);
+  for (auto &handle : handles) handle = make_a();
+  for (auto handle : handles) clcxx::detail::free_obj_ptr<A>(handle);
+  REQUIRE_NOTHROW(clcxx::checked_handle<A>(handles.front()));
+  REQUIRE_THROWS_WITH(clcxx::checked_handle<A>(handles[handles.size() - 16]),
+                      "Handle of a freed object passed as A");
+
+  clcxx::detail::free_obj_ptr<Particle>(particle);
+  clcxx::detail::free_obj_ptr<Circle>(circle);
+  REQUIRE_NOTHROW(clcxx::registry().remove_package("test-handles"));
+}
@@ -0,0 +1,60 @@
+#define CLCXX_PROFILE 1
+
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <clcxx/clcxx.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+int Int(int x) { return x + 100; }
+int Checked(int x) {
+  if (x < 0) throw std::runtime_error("negative");
+  return x;
+}
+
+CLCXX_PACKAGE Profile(clcxx::Package &pack) {
+  pack.defun("test-int", F_PTR(&Int));
+  pack.defun("checked", F_PTR(&Checked));
+}
+
+TEST_CASE("profile counters", "[clcxx]") {
+  clcxx::registry().set_error_handler([](char *) {});
+  REQUIRE(load_package("test-profile", Profile));
+  const auto find_entry = [](void (*thunk)()) {
+    std::vector<clcxx::ProfileEntry> entries(profile_snapshot(nullptr, 0));
+    entries.resize(profile_snapshot(entries.data(), entries.size()));
+    const auto iter =
+        std::find_if(entries.begin(), entries.end(),
+                     [thunk](const auto &e) { return e.thunk == thunk; });
+    REQUIRE(iter != entries.end());
+    return *iter;
+  };
+  profile_reset();
+  auto f = clcxx::Import([&]() { return &Int; });
+  for (int i = 0; i < 3; ++i) {
+    REQUIRE(f(i) == 100 + i);
+  }
+  auto entry = find_entry(reinterpret_cast<void (*)()>(f));
+  REQUIRE(std::string(entry.name) == "test-int");
+  REQUIRE(entry.calls == 3);
+  REQUIRE(entry.errors == 0);
+  uint64_t histogram_calls = 0;
+  for (auto count : entry.latency) histogram_calls += count;
+  REQUIRE(histogram_calls == 3);
+
+  auto checked = clcxx::Import([&]() { return &Checked; });
+  checked(1);
+  checked(-1);
+  entry = find_entry(reinterpret_cast<void (*)()>(checked));
+  REQUIRE(entry.calls == 2);
+  REQUIRE(entry.errors == 1);
+
+  // counters of exited threads are kept
+  std::thread([&f] { f(1); }).join();
+  REQUIRE(find_entry(reinterpret_cast<void (*)()>(f)).calls == 4);
+  profile_reset();
+  REQUIRE(find_entry(reinterpret_cast<void (*)()>(f)).calls == 0);
+  REQUIRE_NOTHROW(clcxx::registry().remove_package("test-profile"));
+}
@@ -0,0 +1,56 @@
+#define CLCXX_TRACE 1
+
+#include <catch2/catch_test_macros.hpp>
+#include <clcxx/clcxx.hpp>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+std::string Greet() { return "Hello, World"; }
+int Int(int x) { return x + 100; }
+
+CLCXX_PACKAGE Trace(clcxx::Package &pack) {
+  pack.defun("greet", F_PTR(&Greet));
+  pack.defun("test-int", F_PTR(&Int));
+}
+
+TEST_CASE("trace dump", "[clcxx]") {
+  trace_clear();
+  trace_start();
+  REQUIRE(load_package("test-trace", Trace));
+  auto f = clcxx::Import([&]() { return &Int; });
+  REQUIRE(f(1) == 101);
+  auto greet = clcxx::Import([&]() { return &Greet; });
+  REQUIRE(delete_string(const_cast<char *>(greet())));
+  std::thread([&f] { f(2); }).join();
+  // pool events are compiled in with CLCXX_TRACE too
+  clcxx::VerboseResource pool(std::pmr::new_delete_resource());
+  pool.deallocate(pool.allocate(16), 16);
+  trace_stop();
+  REQUIRE(f(3) == 103);
+  const std::string path = "clcxx_trace_test.json";
+  REQUIRE(trace_dump(path.c_str()));
+  std::ifstream in(path);
+  const std::string json((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+  in.close();
+  std::remove(path.c_str());
+  const auto count = [&json](const std::string &str) {
+    size_t n = 0;
+    for (auto pos = json.find(str); pos != std::string::npos;
+         pos = json.find(str, pos + 1)) {
+      ++n;
+    }
+    return n;
+  };
+  REQUIRE(json.rfind("{\"displayTimeUnit\"", 0) == 0);
+  REQUIRE(count("\"name\":\"load_package\"") == 1);
+  REQUIRE(count("\"name\":\"collect_thunks\"") == 1);
+  REQUIRE(count("\"name\":\"test-int\",\"ph\":\"X\"") == 2);
+  REQUIRE(count("\"name\":\"pool-allocate\"") >= 1);
+  REQUIRE(count("\"name\":\"pool-deallocate\"") >= 1);
+  REQUIRE(count("\"tid\":") > count("\"tid\":1,"));
+  REQUIRE_NOTHROW(clcxx::registry().remove_package("test-trace"));
+}
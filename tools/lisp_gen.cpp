@@ -0,0 +1,605 @@
+// Generate lisp source with CFFI definitions for a bindings library
+// usage: clcxx-lisp-gen <bindings-library> <package-function>
+//                       <lisp-package> <output.lisp>
+// the generated file calls load_package at load time and resolves
+// thunks by their index in the package thunk table, so no meta data is
+// sent or parsed at runtime.
+
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "clcxx/clcxx.hpp"
+
+namespace {
+
+/// parsed lisp type string, e.g. (:reference (:class A))
+struct TypeNode {
+  std::string atom;
+  std::vector<TypeNode> list;
+  bool is_list() const { return atom.empty(); }
+};
+
+TypeNode ParseType(const std::string &s, size_t &i) {
+  TypeNode node;
+  while (i < s.size() && s[i] == ' ') ++i;
+  if (i < s.size() && s[i] == '(') {
+    ++i;
+    while (i < s.size() && s[i] != ')') {
+      node.list.push_back(ParseType(s, i));
+      while (i < s.size() && s[i] == ' ') ++i;
+    }
+    ++i;
+  } else {
+    auto start = i;
+    while (i < s.size() && s[i] != ' ' && s[i] != ')' && s[i] != '(') ++i;
+    node.atom = s.substr(start, i - start);
+  }
+  return node;
+}
+
+TypeNode ParseType(const std::string &s) {
+  size_t i = 0;
+  return ParseType(s, i);
+}
+
+/// split "a+b+" at top level, ":string+ptr" is a single type
+std::vector<std::string> SplitTypes(const char *types) {
+  std::vector<std::string> vec;
+  if (types == nullptr) return vec;
+  std::string s(types);
+  int depth = 0;
+  size_t start = 0;
+  for (size_t i = 0; i < s.size(); ++i) {
+    if (s[i] == '(') ++depth;
+    if (s[i] == ')') --depth;
+    if (s[i] == '+' && depth == 0 &&
+        (i + 1 == s.size() || s[i + 1] == ':' || s[i + 1] == '(')) {
+      vec.push_back(s.substr(start, i - start));
+      start = i + 1;
+    }
+  }
+  if (start < s.size()) vec.push_back(s.substr(start));
+  return vec;
+}
+
+std::vector<std::string> SplitNames(const char *names) {
+  std::vector<std::string> vec;
+  if (names == nullptr) return vec;
+  std::istringstream stream(names);
+  std::string name;
+  while (std::getline(stream, name, '+')) {
+    vec.push_back(name);
+  }
+  return vec;
+}
+
+std::string LispName(std::string name) {
+  for (auto &c : name) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  return name;
+}
+
+/// lisp name of a function, methods are prefixed with their class since
+/// classes can bind methods of the same name, e.g. iter.begin
+std::string FunctionName(const clcxx::FunctionInfo &f_info) {
+  if (f_info.class_obj == nullptr || f_info.class_obj[0] == '\0') {
+    return LispName(f_info.name);
+  }
+  return LispName(f_info.class_obj) + "-" + LispName(f_info.name);
+}
+
+/// throws if two definitions of the generated source share a name, the
+/// second defun would replace the first one in lisp
+void CheckDuplicateNames(const std::string &source) {
+  std::set<std::string> names;
+  const std::string defun = "\n(defun ";
+  for (auto pos = source.find(defun); pos != std::string::npos;
+       pos = source.find(defun, pos + 1)) {
+    const auto start = pos + defun.size();
+    // (defun name ...) or (defun (setf name) ...)
+    const auto end = source[start] == '(' ? source.find(')', start) + 1
+                                          : source.find(' ', start);
+    const auto name = source.substr(start, end - start);
+    if (!names.insert(name).second) {
+      throw std::runtime_error("Lisp function " + name +
+                               " is defined twice, give the C++ functions"
+                               " distinct names");
+    }
+  }
+}
+
+/// cffi type used to pass or return a value of the given clcxx type
+std::string CffiType(const TypeNode &t) {
+  if (!t.is_list()) {
+    if (t.atom == ":string+ptr") return ":string";
+    if (t.atom == ":string-view") return "(:struct string-view)";
+    return t.atom;
+  }
+  const auto &head = t.list.at(0).atom;
+  if (head == ":struct") return "(:struct " + LispName(t.list.at(1).atom) + ")";
+  if (head == ":complex") {
+    return t.list.at(1).atom == ":float" ? "(:struct complex-float)"
+                                         : "(:struct complex-double)";
+  }
+  if (head == ":span") return "(:struct span)";
+  // :pointer :reference :const-reference :rvalue-reference :class :array
+  return ":pointer";
+}
+
+std::string SlotType(const TypeNode &t) {
+  if (t.is_list() && t.list.at(0).atom == ":array") {
+    return CffiType(t.list.at(1)) + " :count " + t.list.at(2).atom;
+  }
+  return CffiType(t);
+}
+
+void WritePreamble(std::ostream &out, const std::string &lisp_pack,
+                   const std::string &package_function, size_t n_thunks) {
+  out << ";;;; Generated by clcxx-lisp-gen, do not edit.\n"
+      << ";;;; Package function: " << package_function << "\n\n"
+      << "(cl:defpackage #:" << lisp_pack << " (:use #:cl))\n"
+      << "(cl:in-package #:" << lisp_pack << ")\n\n"
+      << "(cffi:defcstruct complex-float (real :float) (imag :float))\n"
+      << "(cffi:defcstruct complex-double (real :double) (imag :double))\n"
+      << "(cffi:defcstruct span (data :pointer) (size :size))\n"
+      << "(cffi:defcstruct string-view (data :pointer) (size :size))\n\n"
+      << "(cffi:defcfun (\"clcxx_init\" %clcxx-init) :bool\n"
+      << "  (error-handler :pointer) (reg-data-callback :pointer))\n"
+      << "(cffi:defcfun (\"load_package\" %load-package) :bool\n"
+      << "  (name :string) (regfunc :pointer))\n"
+      << "(cffi:defcfun (\"package_thunks\" %package-thunks) :size\n"
+      << "  (name :string) (thunks :pointer) (n :size))\n"
+      << "(cffi:defcfun (\"reserve_objects\" %reserve-objects) :bool\n"
+      << "  (pack :string) (class :string) (n :size))\n"
+      << "(cffi:defcfun (\"class_index_table\" %class-index-table) :pointer\n"
+      << "  (pack :string))\n"
+      << "(cffi:defcfun (\"class_slot_table\" %class-slot-table) :pointer\n"
+      << "  (pack :string) (class :string))\n"
+      << "(cffi:defcfun (\"delete_string\" %delete-string) :bool\n"
+      << "  (str :pointer))\n"
+      << "(cffi:defcfun (\"async_call\" %async-call-thunk) :pointer\n"
+      << "  (thunk :pointer) (args :pointer))\n"
+      << "(cffi:defcfun (\"async_poll\" %async-poll) :int (handle :pointer))\n"
+      << "(cffi:defcfun (\"async_wait\" %async-wait) :int\n"
+      << "  (handle :pointer) (timeout-ms :int64))\n"
+      << "(cffi:defcfun (\"async_cancel\" %async-cancel) :bool\n"
+      << "  (handle :pointer))\n"
+      << "(cffi:defcfun (\"async_collect\" %async-collect) :bool\n"
+      << "  (handle :pointer) (result :pointer))\n"
+      << "(cffi:defcfun (\"async_release\" %async-release) :void\n"
+      << "  (handle :pointer))\n"
+      << "(cffi:defcfun (\"set_async_threads\" async-threads) :bool\n"
+      << "  (n :size))\n"
+      << ";; (parallel-map (svref *thunks* i) columns output n threads)\n"
+      << "(cffi:defcfun (\"parallel_map\" parallel-map) :bool\n"
+      << "  (thunk :pointer) (input-columns :pointer) (output :pointer)\n"
+      << "  (n :size) (n-threads :size))\n"
+      << ";; filled when the bindings are built with CLCXX_PROFILE=1\n"
+      << "(cffi:defcstruct profile-entry (thunk :pointer) (name :string)\n"
+      << "  (calls :uint64) (errors :uint64)\n"
+      << "  (latency :uint64 :count " << clcxx::PROFILE_BUCKETS << "))\n"
+      << "(cffi:defcfun (\"profile_snapshot\" %profile-snapshot) :size\n"
+      << "  (entries :pointer) (n :size))\n"
+      << "(cffi:defcfun (\"profile_reset\" profile-reset) :void)\n"
+      << "(cffi:defcfun (\"trace_start\" trace-start) :void)\n"
+      << "(cffi:defcfun (\"trace_stop\" trace-stop) :void)\n"
+      << "(cffi:defcfun (\"trace_clear\" trace-clear) :void)\n"
+      << "(cffi:defcfun (\"trace_dump\" trace-dump) :bool (path :string))\n\n"
+      << ";; async calls, see clcxx::AsyncState\n"
+      << "(defstruct (async-result (:constructor %make-async-result\n"
+      << "                             (handle type strings)))\n"
+      << "  handle type strings)\n\n"
+      << "(defun %async-state (state)\n"
+      << "  (nth state '(:queued :running :done :failed :cancelled)))\n\n"
+      << "(defun %async-slot-size (arg-type)\n"
+      << "  ;; pods are passed by value up to CLCXX_POD_BY_VALUE_MAX_SIZE\n"
+      << "  (cffi:foreign-type-size\n"
+      << "   (if (eq arg-type :string) :pointer arg-type)))\n\n"
+      << "(defun %async-call (thunk types args type)\n"
+      << "  ;; argument values are copied by C++, strings live until collected\n"
+      << "  (let ((n (length args)) (places '()) (strings '()))\n"
+      << "    (cffi:with-foreign-object (argv :pointer (max n 1))\n"
+      << "      (unwind-protect\n"
+      << "           (progn\n"
+      << "             (loop for arg in args for arg-type in types for i from 0\n"
+      << "                   for size = (%async-slot-size arg-type)\n"
+      << "                   for place = (cffi:foreign-alloc :char :count size)\n"
+      << "                   do (push place places)\n"
+      << "                      (setf (cffi:mem-aref argv :pointer i) place)\n"
+      << "                      (if (eq arg-type :string)\n"
+      << "                          (let ((str (cffi:foreign-string-alloc arg)))\n"
+      << "                            (push str strings)\n"
+      << "                            (setf (cffi:mem-ref place :pointer) str))\n"
+      << "                          (setf (cffi:mem-ref place arg-type) arg)))\n"
+      << "             (%make-async-result (%async-call-thunk thunk argv)\n"
+      << "                                 type strings))\n"
+      << "        (mapc #'cffi:foreign-free places)))))\n\n"
+      << "(defun async-poll (result)\n"
+      << "  (%async-state (%async-poll (async-result-handle result))))\n\n"
+      << "(defun async-wait (result &optional (timeout-ms -1))\n"
+      << "  (%async-state (%async-wait (async-result-handle result) timeout-ms)))"
+         "\n\n"
+      << "(defun async-cancel (result)\n"
+      << "  (%async-cancel (async-result-handle result)))\n\n"
+      << "(defun async-collect (result)\n"
+      << "  \"Wait for the call, convert its result and release it\"\n"
+      << "  (let ((handle (async-result-handle result))\n"
+      << "        (type (async-result-type result)))\n"
+      << "    (%async-wait handle -1)\n"
+      << "    (cffi:with-foreign-pointer\n"
+      << "        (out (if (member type '(:void :string+ptr)) 8\n"
+      << "                 (max 8 (cffi:foreign-type-size type))))\n"
+      << "      (unwind-protect\n"
+      << "           (when (%async-collect handle out)\n"
+      << "             (cond ((eq type :void) nil)\n"
+      << "                   ((eq type :string+ptr)\n"
+      << "                    (let ((ptr (cffi:mem-ref out :pointer)))\n"
+      << "                      (prog1 (cffi:foreign-string-to-lisp ptr)\n"
+      << "                        (%delete-string ptr))))\n"
+      << "                   (t (cffi:mem-ref out type))))\n"
+      << "        (%async-release handle)\n"
+      << "        (mapc #'cffi:foreign-string-free (async-result-strings result))"
+         "\n"
+      << "        (setf (async-result-handle result) (cffi:null-pointer)\n"
+      << "              (async-result-strings result) '())))))\n\n"
+      << ";; overload dispatch, see clcxx::detail::ArgCode\n"
+      << "(defun %arg-code (arg pointer-code)\n"
+      << "  (typecase arg\n"
+      << "    (integer 1) (real 2) ((member t nil) 3) (string 4)\n"
+      << "    (t pointer-code)))\n\n"
+      << "(defun %overload-tag (args pointer-code)\n"
+      << "  (loop for arg in args for shift from 4 by 3\n"
+      << "        sum (ash (%arg-code arg pointer-code) shift) into codes\n"
+      << "        finally (return (+ (length args) codes))))\n\n"
+      << "(defun %call-overload (thunk args overloads)\n"
+      << "  ;; foreign pointers are objects, or pod structs passed by pointer\n"
+      << "  (let* ((n (length args))\n"
+      << "         (tag (if (assoc (%overload-tag args 5) overloads)\n"
+      << "                  (%overload-tag args 5)\n"
+      << "                  (%overload-tag args 6)))\n"
+      << "         (type (cdr (assoc tag overloads)))\n"
+      << "         (strings '()))\n"
+      << "    (unless type (error \"No C++ overload for ~S\" args))\n"
+      << "    (cffi:with-foreign-objects ((argv :pointer (max n 1))\n"
+      << "                                (slots :uint64 (max n 1)))\n"
+      << "     (cffi:with-foreign-pointer\n"
+      << "         (result (if (member type '(:void :string+ptr)) 8\n"
+      << "                     (max 8 (cffi:foreign-type-size type))))\n"
+      << "      (loop for arg in args for i from 0\n"
+      << "            for place = (cffi:mem-aptr slots :uint64 i)\n"
+      << "            do (setf (cffi:mem-aref argv :pointer i) place)\n"
+      << "               (ecase (%arg-code arg 5)\n"
+      << "                 (1 (setf (cffi:mem-ref place :int64) arg))\n"
+      << "                 (2 (setf (cffi:mem-ref place :double)\n"
+      << "                          (coerce arg 'double-float)))\n"
+      << "                 (3 (setf (cffi:mem-ref place :bool) arg))\n"
+      << "                 (4 (let ((str (cffi:foreign-string-alloc arg)))\n"
+      << "                      (push str strings)\n"
+      << "                      (setf (cffi:mem-ref place :pointer) str)))\n"
+      << "                 (5 (if (= (ldb (byte 3 (+ 4 (* 3 i))) tag) 6)\n"
+      << "                        (setf (cffi:mem-aref argv :pointer i) arg)\n"
+      << "                        (setf (cffi:mem-ref place :pointer) arg)))))\n"
+      << "      (cffi:foreign-funcall-pointer thunk () :uint64 tag :pointer argv\n"
+      << "                                    :pointer result :void)\n"
+      << "      (mapc #'cffi:foreign-string-free strings)\n"
+      << "      (cond ((eq type :void) nil)\n"
+      << "            ((eq type :string+ptr)\n"
+      << "             (let ((ptr (cffi:mem-ref result :pointer)))\n"
+      << "               (prog1 (cffi:foreign-string-to-lisp ptr)\n"
+      << "                 (%delete-string ptr))))\n"
+      << "            (t (cffi:mem-ref result type)))))))\n\n"
+      << "(cffi:defcallback %lisp-error :void ((err :string))\n"
+      << "  (error \"C++ error: ~A\" err))\n\n"
+      << "(defconstant +thunks-count+ " << n_thunks << ")\n"
+      << "(defvar *thunks* (make-array +thunks-count+))\n\n"
+      << "(defun load-thunks ()\n"
+      << "  (%clcxx-init (cffi:callback %lisp-error) (cffi:null-pointer))\n"
+      << "  (unless (%load-package \"" << lisp_pack
+      << "\" (cffi:foreign-symbol-pointer \"" << package_function << "\"))\n"
+      << "    (error \"Failed to load C++ package " << lisp_pack << "\"))\n"
+      << "  (cffi:with-foreign-object (table :pointer +thunks-count+)\n"
+      << "    (let ((n (%package-thunks \"" << lisp_pack
+      << "\" table +thunks-count+)))\n"
+      << "      (unless (= n +thunks-count+)\n"
+      << "        (error \"C++ package " << lisp_pack
+      << " changed, regenerate its lisp bindings\")))\n"
+      << "    (dotimes (i +thunks-count+)\n"
+      << "      (setf (svref *thunks* i) (cffi:mem-aref table :pointer i)))))\n\n"
+      << "(load-thunks)\n\n"
+      << ";; class indexes of the package for the dynamic-class functions\n"
+      << "(defparameter *class-indexes* (%class-index-table \"" << lisp_pack
+      << "\"))\n\n";
+}
+
+/// index of a class thunk in the package thunk table, class thunks start
+/// at index in the order of clcxx::detail::class_thunks
+std::string ClassThunk(const clcxx::ClassInfo &c_info, size_t index,
+                       void (*thunk)()) {
+  const auto thunks = clcxx::detail::class_thunks(c_info);
+  for (size_t i = 0; i < thunks.size(); ++i) {
+    if (thunks[i] == thunk) return std::to_string(index + i);
+  }
+  throw std::runtime_error("Missing thunk of class " +
+                           std::string(c_info.name));
+}
+
+/// make-<class> takes the arguments of one of the constructors, the
+/// default one or the first constructor<Args...>() of each arity
+void WriteMake(std::ostream &out, const clcxx::ClassInfo &c_info,
+               size_t index,
+               const std::vector<clcxx::FunctionInfo> &functions) {
+  auto name = LispName(c_info.name);
+  std::vector<size_t> arities;
+  std::ostringstream cases;
+  if (c_info.constructor != nullptr) {
+    arities.push_back(0);
+    cases << "\n    (0 (cffi:foreign-funcall-pointer (svref *thunks* "
+          << ClassThunk(c_info, index, c_info.constructor)
+          << ") () :pointer))";
+  }
+  for (const auto &ctor : SplitNames(c_info.constructors)) {
+    for (const auto &f_info : functions) {
+      if (ctor != f_info.name ||
+          std::strcmp(f_info.class_obj, c_info.name) != 0) {
+        continue;
+      }
+      const auto arity = SplitTypes(f_info.arg_types).size();
+      if (std::find(arities.begin(), arities.end(), arity) == arities.end()) {
+        arities.push_back(arity);
+        cases << "\n    (" << arity << " (apply #'" << FunctionName(f_info)
+              << " args))";
+      }
+      break;
+    }
+  }
+  if (arities.empty()) return;
+  for (const auto &f_info : functions) {
+    if (FunctionName(f_info) == "make-" + name) {
+      out << ";; make-" << name << " is a package function\n";
+      return;
+    }
+  }
+  out << "(defun make-" << name << " (&rest args)\n"
+      << "  (case (length args)" << cases.str() << "\n"
+      << "    (t (error \"No constructor of " << c_info.name
+      << " takes ~D arguments\" (length args)))))\n";
+}
+
+void WriteClass(std::ostream &out, const clcxx::ClassInfo &c_info,
+                size_t index, const std::string &lisp_pack,
+                const std::vector<clcxx::FunctionInfo> &functions) {
+  auto name = LispName(c_info.name);
+  auto slot_names = SplitNames(c_info.slot_names);
+  auto slot_types = SplitTypes(c_info.slot_types);
+  if (c_info.destructor == nullptr) {
+    // pod struct
+    out << "(cffi:defcstruct " << name;
+    for (size_t i = 0; i < slot_names.size() && i < slot_types.size(); ++i) {
+      out << "\n  (" << slot_names[i] << " "
+          << SlotType(ParseType(slot_types[i])) << ")";
+    }
+    out << ")\n\n";
+    return;
+  }
+  out << ";; class " << c_info.name << ": thunks " << index << "..\n"
+      << "(defconstant +" << name << "-size+ " << c_info.size << ")\n"
+      << "(defconstant +" << name << "-alignment+ " << c_info.alignment
+      << ")\n";
+  WriteMake(out, c_info, index, functions);
+  out << "(defun destroy-" << name << " (obj)\n"
+      << "  (cffi:foreign-funcall-pointer (svref *thunks* "
+      << ClassThunk(c_info, index, c_info.destructor)
+      << ") () :pointer obj :void))\n";
+  // direct memory access to fundamental slots
+  auto slot_offsets = SplitNames(c_info.slot_offsets);
+  for (size_t i = 0; i < slot_names.size() && i < slot_types.size() &&
+                     i < slot_offsets.size();
+       ++i) {
+    auto type = ParseType(slot_types[i]);
+    if (type.is_list() || type.atom == ":string+ptr" ||
+        std::stol(slot_offsets[i]) < 0) {
+      continue;
+    }
+    auto accessor = name + "-" + LispName(slot_names[i]);
+    out << "(declaim (inline " << accessor << " (setf " << accessor << ")))\n"
+        << "(defun " << accessor << " (obj)\n"
+        << "  (cffi:mem-ref obj " << type.atom << " " << slot_offsets[i]
+        << "))\n"
+        << "(defun (setf " << accessor << ") (value obj)\n"
+        << "  (setf (cffi:mem-ref obj " << type.atom << " " << slot_offsets[i]
+        << ") value))\n";
+  }
+  if (c_info.buffer != nullptr) {
+    out << ";; buffer element type " << c_info.buffer_type << "\n"
+        << "(defun " << name << "-buffer (obj info)\n"
+        << "  (cffi:foreign-funcall-pointer (svref *thunks* "
+        << ClassThunk(c_info, index, c_info.buffer)
+        << ") () :pointer obj :pointer info :void))\n";
+  }
+  out << ";; snapshot buffer: " << c_info.snapshot_size << " bytes, offsets "
+      << (c_info.snapshot_offsets ? c_info.snapshot_offsets : "") << "\n"
+      << "(defparameter *" << name << "-slots*\n"
+      << "  (%class-slot-table \"" << lisp_pack << "\" \"" << c_info.name
+      << "\"))\n"
+      << "(defun " << name << "-snapshot (obj buffer)\n"
+      << "  (cffi:foreign-funcall-pointer (svref *thunks* "
+      << ClassThunk(c_info, index, c_info.snapshot) << ") () :pointer *"
+      << name << "-slots*\n   :pointer obj :pointer buffer :void))\n"
+      << "(defun " << name << "-restore (obj buffer)\n"
+      << "  (cffi:foreign-funcall-pointer (svref *thunks* "
+      << ClassThunk(c_info, index, c_info.restore) << ") () :pointer *"
+      << name << "-slots*\n   :pointer obj :pointer buffer :void))\n";
+  if (c_info.reserve != nullptr) {
+    out << "(defun reserve-" << name << " (n)\n"
+        << "  (%reserve-objects \"" << lisp_pack << "\" \"" << c_info.name
+        << "\" n))\n";
+  }
+  // upcast: add the offset to the object pointer, downcast: subtract it
+  auto supers = SplitNames(c_info.super_classes);
+  auto super_offsets = SplitNames(c_info.super_offsets);
+  if (!supers.empty()) {
+    out << "(defparameter *" << name << "-super-offsets*\n  '(";
+    for (size_t i = 0; i < supers.size() && i < super_offsets.size(); ++i) {
+      out << (i == 0 ? "" : " ") << "(" << LispName(supers[i]) << " . "
+          << super_offsets[i] << ")";
+    }
+    out << "))\n";
+  }
+  if (c_info.dynamic_class != nullptr) {
+    out << "(defun " << name << "-dynamic-class (obj)\n"
+        << "  \"Class index of the dynamic type and the complete object\"\n"
+        << "  (cffi:with-foreign-object (most-derived :pointer)\n"
+        << "    (values (cffi:foreign-funcall-pointer (svref *thunks* "
+        << ClassThunk(c_info, index, c_info.dynamic_class) << ") ()\n"
+        << "              :pointer *class-indexes* :pointer obj\n"
+        << "              :pointer most-derived :int64)\n"
+        << "            (cffi:mem-ref most-derived :pointer))))\n";
+  }
+  // objects constructed in lisp memory by create-*-at or placed results
+  out << "(defun destruct-" << name << " (obj)\n"
+      << "  (cffi:foreign-funcall-pointer (svref *thunks* "
+      << ClassThunk(c_info, index, c_info.destruct)
+      << ") () :pointer obj :void))\n";
+  out << "\n";
+}
+
+/// overloads share one dispatcher thunk, the tag is computed in lisp
+void WriteOverload(std::ostream &out, const clcxx::FunctionInfo &f_info,
+                   size_t index) {
+  auto tags = SplitNames(f_info.overload_tags);
+  auto return_types = SplitTypes(f_info.overload_return_types);
+  out << "(defun " << FunctionName(f_info) << " (&rest args)\n"
+      << "  (%call-overload (svref *thunks* " << index << ") args\n"
+      << "                  '(";
+  for (size_t i = 0; i < tags.size() && i < return_types.size(); ++i) {
+    auto type = ParseType(return_types[i]);
+    out << (i == 0 ? "" : " ") << "(" << tags[i] << " . "
+        << (!type.is_list() && type.atom == ":string+ptr" ? type.atom
+                                                          : CffiType(type))
+        << ")";
+  }
+  out << ")))\n\n";
+}
+
+void WriteFunction(std::ostream &out, const clcxx::FunctionInfo &f_info,
+                   size_t index) {
+  if (f_info.overload_tags != nullptr) {
+    WriteOverload(out, f_info, index);
+    return;
+  }
+  auto args = SplitTypes(f_info.arg_types);
+  auto return_type = ParseType(f_info.return_type);
+  std::ostringstream params, call_args;
+  for (size_t i = 0; i < args.size(); ++i) {
+    params << (i == 0 ? "" : " ") << "v" << i;
+    call_args << " " << CffiType(ParseType(args[i])) << " v" << i;
+  }
+  out << "(defun " << FunctionName(f_info) << " (" << params.str();
+  if (f_info.out_return_p && return_type.is_list() &&
+      return_type.list.at(0).atom == ":class") {
+    // placed class results, out has the class size and alignment
+    out << (args.empty() ? "" : " ") << "out";
+  } else if (f_info.out_return_p) {
+    out << (args.empty() ? "" : " ") << "&optional (out (cffi:foreign-alloc '"
+        << CffiType(return_type) << "))";
+  }
+  out << ")\n";
+  std::string call = "(cffi:foreign-funcall-pointer (svref *thunks* " +
+                     std::to_string(index) + ") ()" +
+                     (f_info.out_return_p ? " :pointer out" : "") +
+                     call_args.str();
+  if (f_info.out_return_p) {
+    out << "  " << call << " :void)\n  out)\n\n";
+  } else if (!return_type.is_list() && return_type.atom == ":string+ptr") {
+    out << "  (multiple-value-bind (str ptr)\n      " << call
+        << " :string+ptr)\n    (%delete-string ptr)\n    str))\n\n";
+  } else {
+    out << "  " << call << " " << CffiType(return_type) << "))\n\n";
+  }
+  if (f_info.out_return_p) return;
+  // same arguments, returns an async-result for async-collect
+  std::ostringstream arg_types;
+  for (size_t i = 0; i < args.size(); ++i) {
+    arg_types << (i == 0 ? "" : " ") << CffiType(ParseType(args[i]));
+  }
+  out << "(defun " << FunctionName(f_info) << "-async (" << params.str()
+      << ")\n  (%async-call (svref *thunks* " << index << ") '("
+      << arg_types.str() << ") "
+      << (args.empty() ? "'()" : "(list " + params.str() + ")") << "\n"
+      << "               '"
+      << (!return_type.is_list() && return_type.atom == ":string+ptr"
+              ? return_type.atom
+              : CffiType(return_type))
+      << "))\n\n";
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 5) {
+    std::cerr << "usage: " << argv[0]
+              << " <bindings-library> <package-function> <lisp-package>"
+                 " <output.lisp>\n";
+    return 1;
+  }
+  const std::string package_function = argv[2];
+  const std::string lisp_pack = argv[3];
+
+  auto handle = dlopen(argv[1], RTLD_NOW | RTLD_LOCAL);
+  if (handle == nullptr) {
+    std::cerr << "dlopen: " << dlerror() << "\n";
+    return 1;
+  }
+  auto regfunc = reinterpret_cast<void (*)(clcxx::Package &)>(
+      dlsym(handle, package_function.c_str()));
+  if (regfunc == nullptr) {
+    std::cerr << "dlsym: " << dlerror() << "\n";
+    return 1;
+  }
+
+  clcxx::registry().set_error_handler(
+      [](char *err_msg) { std::cerr << err_msg << "\n"; });
+  try {
+    clcxx::Package &pack = clcxx::registry().create_package(lisp_pack);
+    regfunc(pack);
+    pack.collect_thunks();
+
+    std::ostringstream out;
+    WritePreamble(out, lisp_pack, package_function, pack.thunks().size());
+    size_t index = 0;
+    for (const auto &Constant : pack.constants_meta_data()) {
+      out << "(defconstant +" << LispName(Constant.name) << "+ "
+          << Constant.value << ")\n\n";
+    }
+    for (const auto &Class : pack.classes_meta_data()) {
+      WriteClass(out, Class, index, lisp_pack, pack.functions_meta_data());
+      index += clcxx::detail::class_thunks(Class).size();
+    }
+    for (const auto &Func : pack.functions_meta_data()) {
+      WriteFunction(out, Func, index++);
+    }
+    CheckDuplicateNames(out.str());
+    std::ofstream file(argv[4]);
+    file << out.str();
+    if (!file) {
+      std::cerr << "failed to write " << argv[4] << "\n";
+      return 1;
+    }
+    clcxx::registry().remove_package(lisp_pack);
+  } catch (const std::exception &err) {
+    std::cerr << err.what() << "\n";
+    return 1;
+  }
+  return 0;
+}